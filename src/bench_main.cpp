@@ -0,0 +1,517 @@
+#include "uv_mapper/indexed_half_edge_mesh.hpp"
+#include "uv_mapper/parallel.hpp"
+#include "uv_mapper/uv_mapper.hpp"
+#include "uv_mapper/uv_mapper_async.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/*
+  Benchmarks of the uv mapper, on generated meshes of any size:
+
+  auto_uv_bench build [--vertices=N] [--max-threads=T]
+    Builds the half edge mesh with 1, 2, 4, ... up to T threads, and checks that every
+    build is identical to the one on a single thread.
+
+  auto_uv_bench multigrid [--min-vertices=N] [--max-vertices=M]
+    Maps meshes of N, 2N, 5N, 10N, ... up to M vertices with UV_MAP_SOLVER_MULTIGRID and
+    with Conjugate Gradient preconditioned by multigrid, to show that the number of
+    iterations stays about the same as the mesh grows.
+
+  auto_uv_bench mixed [--vertices=N]
+    Maps the mesh with UV_MAP_SOLVER_CHOLESKY, and with UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY
+    at a few tolerances, and compares their time, the memory of their factors, and how far
+    their uvs are from those of the double precision factorization.
+
+  auto_uv_bench supernodal [--vertices=N] [--max-threads=T]
+    Maps the mesh with single threaded sparse LU, and then with the "supernodal" backend
+    on 1, 2, 4, ... up to T threads, and compares their times and their uvs.
+
+  auto_uv_bench async [--vertices=N]
+    Maps the mesh with uvMapAsync, and checks that the stages of a call are reported in order,
+    that cancelling works for a call that waits for a thread, for a running call with
+    UvMapJob::Cancel, and for several calls that share options.cancel, and that destroying a
+    pool cancels the calls still in it. Prints every check, and fails if one does not hold.
+
+  The meshes are square grids, bent into a bumpy height field, so that their vertices
+  have a boundary to map onto the circle, and harmonic weights that differ everywhere.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// a grid with about numVertices vertices, and two triangles for every cell.
+void MakeGrid(size_t numVertices, vector<float>& positions, vector<int>& indices) {
+    const int n = (int)sqrt((double)numVertices) > 2 ? (int)sqrt((double)numVertices) : 2;
+
+    positions.clear();
+    indices.clear();
+    positions.reserve((size_t)n * n * 3);
+    indices.reserve((size_t)(n - 1) * (n - 1) * 6);
+
+    for(int j = 0; j < n; j++) {
+        for(int i = 0; i < n; i++) {
+            float x = i / (float)(n - 1);
+            float y = j / (float)(n - 1);
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(0.2f * sinf(7.0f * x) * cosf(5.0f * y));
+        }
+    }
+
+    for(int j = 0; j < n - 1; j++) {
+        for(int i = 0; i < n - 1; i++) {
+            int a = j * n + i;
+            int b = a + 1;
+            int c = a + n;
+            int d = c + 1;
+
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(d);
+
+            indices.push_back(a);
+            indices.push_back(d);
+            indices.push_back(c);
+        }
+    }
+}
+
+// Whether the two meshes have exactly the same half edges, edges, boundary loops and vertex edges.
+bool SameMesh(const IndexedHalfEdgeMesh& a, const IndexedHalfEdgeMesh& b) {
+    if(a.NumVertices() != b.NumVertices() || a.NumEdges() != b.NumEdges() ||
+       a.NumHalfEdges() != b.NumHalfEdges() || a.NumBoundaryLoops() != b.NumBoundaryLoops()) {
+        return false;
+    }
+
+    for(HalfEdgeIndex he = 0; he < a.NumHalfEdges(); he++) {
+        if(a.Next(he) != b.Next(he) || a.Twin(he) != b.Twin(he) || a.Vertex(he) != b.Vertex(he) ||
+           a.Face(he) != b.Face(he) || a.Edge(he) != b.Edge(he) || a.BoundaryLoop(he) != b.BoundaryLoop(he)) {
+            return false;
+        }
+        if(a.IsBoundaryHalfEdge(he) && a.GetNextBoundary(he) != b.GetNextBoundary(he)) {
+            return false;
+        }
+    }
+    for(EdgeIndex e = 0; e < a.NumEdges(); e++) {
+        if(a.EdgeHalfEdge(e) != b.EdgeHalfEdge(e)) {
+            return false;
+        }
+    }
+    for(uint32_t loop = 0; loop < a.NumBoundaryLoops(); loop++) {
+        if(a.BoundaryLoopHalfEdge(loop) != b.BoundaryLoopHalfEdge(loop) ||
+           a.BoundaryLoopLength(loop) != b.BoundaryLoopLength(loop)) {
+            return false;
+        }
+    }
+    for(VertexIndex v = 0; v < a.NumVertices(); v++) {
+        if(a.VertexHalfEdge(v) != b.VertexHalfEdge(v) || a.Valence(v) != b.Valence(v)) {
+            return false;
+        }
+        for(uint32_t i = 0; i < a.Valence(v); i++) {
+            if(a.VertexEdgesBegin(v)[i] != b.VertexEdgesBegin(v)[i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The time of the fastest of a few builds, which leaves out the first touch of the memory.
+double TimeBuild(IndexedHalfEdgeMesh& mesh, const vector<float>& positions, const vector<int>& indices, int numThreads) {
+    double best = 0.0;
+    for(int run = 0; run < 3; run++) {
+        Clock::time_point start = Clock::now();
+        if(!mesh.Build(positions.data(), positions.size() / 3, indices.data(), indices.size() / 3, numThreads)) {
+            printf("ERROR: the benchmark mesh is not valid\n");
+            exit(1);
+        }
+        double ms = MillisecondsSince(start);
+        if(run == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+int BenchBuild(size_t numVertices, int maxThreads) {
+    vector<float> positions;
+    vector<int> indices;
+    MakeGrid(numVertices, positions, indices);
+    printf("building a mesh of %d vertices and %d triangles, on %d hardware threads\n",
+           (int)(positions.size() / 3), (int)(indices.size() / 3), NumHardwareThreads());
+
+    IndexedHalfEdgeMesh serial;
+    const double serialMs = TimeBuild(serial, positions, indices, 1);
+
+    printf("%8s %12s %10s %10s\n", "threads", "ms", "speedup", "identical");
+    printf("%8d %12.1f %10.2f %10s\n", 1, serialMs, 1.0, "yes");
+
+    bool allSame = true;
+    IndexedHalfEdgeMesh mesh;
+    for(int numThreads = 2; numThreads <= maxThreads; numThreads *= 2) {
+        const double ms = TimeBuild(mesh, positions, indices, numThreads);
+        const bool same = SameMesh(serial, mesh);
+        allSame = allSame && same;
+        printf("%8d %12.1f %10.2f %10s\n", numThreads, ms, serialMs / ms, same ? "yes" : "NO");
+    }
+
+    if(!allSame) {
+        printf("ERROR: a multithreaded build differs from the serial build\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Maps the mesh with the options, in a workspace of its own, and times it. Returns false,
+// after printing why, if it failed.
+bool BenchMap(const vector<float>& positions, const vector<int>& indices, const char* name, const UvMapOptions& options,
+              vector<float>& uvs, UvMapStats& stats, double& ms) {
+    const size_t numVertices = positions.size() / 3;
+    uvs.assign(numVertices * 2, 0.0f);
+    UvMapWorkspace workspace;
+    stats = UvMapStats();
+
+    Clock::time_point start = Clock::now();
+    const UvMapStatus status = uvMap(positions.data(), numVertices, indices.data(), indices.size() / 3,
+                                     uvs.data(), NULL, workspace, options, &stats);
+    ms = MillisecondsSince(start);
+    if(status != UV_MAP_SUCCESS) {
+        printf("ERROR: %s failed to map the benchmark mesh: %s\n", name, uvMapStatusMessage(status));
+        return false;
+    }
+    return true;
+}
+
+// Maps the mesh with an iterative solver, and prints a line of the stats.
+bool BenchIterative(const vector<float>& positions, const vector<int>& indices, const char* name, const UvMapOptions& options) {
+    vector<float> uvs;
+    UvMapStats stats;
+    double ms;
+    if(!BenchMap(positions, indices, name, options, uvs, stats, ms)) {
+        return false;
+    }
+
+    const size_t numVertices = positions.size() / 3;
+    printf("%10d %-12s %10d %12.3g %12.1f %12.1f %12.3f\n", (int)numVertices, name, stats.iterations,
+           stats.residual, stats.factorizeMilliseconds, ms, ms * 1000.0 / numVertices);
+    return true;
+}
+
+int BenchMultigrid(size_t minVertices, size_t maxVertices) {
+    printf("%10s %-12s %10s %12s %12s %12s %12s\n",
+           "vertices", "solver", "iterations", "residual", "setup ms", "total ms", "us/vertex");
+
+    UvMapOptions multigrid;
+    multigrid.solver = UV_MAP_SOLVER_MULTIGRID;
+    UvMapOptions cg;
+    cg.solver = UV_MAP_SOLVER_CONJUGATE_GRADIENT;
+    cg.preconditioner = UV_MAP_PRECONDITIONER_MULTIGRID;
+
+    // 1, 2, 5, 10, 20, 50, ... times minVertices.
+    const int steps[] = { 1, 2, 5 };
+    for(size_t decade = minVertices; decade <= maxVertices; decade *= 10) {
+        for(int i = 0; i < 3; i++) {
+            const size_t numVertices = decade * steps[i];
+            if(numVertices > maxVertices) {
+                break;
+            }
+            vector<float> positions;
+            vector<int> indices;
+            MakeGrid(numVertices, positions, indices);
+            if(!BenchIterative(positions, indices, "multigrid", multigrid) ||
+               !BenchIterative(positions, indices, "cg+multigrid", cg)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// the largest difference between the uvs.
+double MaxDifference(const vector<float>& a, const vector<float>& b) {
+    double maxDifference = 0.0;
+    for(size_t k = 0; k < a.size(); k++) {
+        maxDifference = std::max(maxDifference, (double)fabs(a[k] - b[k]));
+    }
+    return maxDifference;
+}
+
+int BenchMixed(size_t numVertices) {
+    vector<float> positions;
+    vector<int> indices;
+    MakeGrid(numVertices, positions, indices);
+    printf("mapping a mesh of %d vertices\n", (int)(positions.size() / 3));
+    printf("%-24s %6s %12s %12s %12s %12s %12s\n",
+           "solver", "steps", "residual", "factor MB", "factorize ms", "total ms", "max uv error");
+
+    // the double precision factorization, that the others are compared with.
+    UvMapOptions options;
+    options.solver = UV_MAP_SOLVER_CHOLESKY;
+    vector<float> reference;
+    UvMapStats stats;
+    double ms;
+    if(!BenchMap(positions, indices, "cholesky", options, reference, stats, ms)) {
+        return 1;
+    }
+    // the values and the row indices of the factor.
+    printf("%-24s %6d %12s %12.1f %12.1f %12.1f %12s\n", "cholesky", 0, "-",
+           stats.factorNonZeros * (sizeof(double) + sizeof(int)) / 1e6, stats.factorizeMilliseconds, ms, "-");
+
+    const double tolerances[] = { 1e-4, 1e-6, 1e-8, 1e-10 };
+    for(int i = 0; i < 4; i++) {
+        options.solver = UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY;
+        options.tolerance = tolerances[i];
+        vector<float> uvs;
+        if(!BenchMap(positions, indices, "mixed", options, uvs, stats, ms)) {
+            return 1;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "mixed, tolerance %g", tolerances[i]);
+        printf("%-24s %6d %12.3g %12.1f %12.1f %12.1f %12.3g\n", name, stats.iterations, stats.residual,
+               stats.factorNonZeros * (sizeof(float) + sizeof(int)) / 1e6, stats.factorizeMilliseconds, ms, MaxDifference(uvs, reference));
+    }
+    return 0;
+}
+
+int BenchSupernodal(size_t numVertices, int maxThreads) {
+    vector<float> positions;
+    vector<int> indices;
+    MakeGrid(numVertices, positions, indices);
+    printf("mapping a mesh of %d vertices, on %d hardware threads\n", (int)(positions.size() / 3), NumHardwareThreads());
+    printf("%-12s %8s %12s %12s %12s %12s %12s\n",
+           "solver", "threads", "factor nnz", "factorize ms", "total ms", "speedup", "max uv diff");
+
+    UvMapOptions options;
+    options.solver = UV_MAP_SOLVER_LU;
+    options.numThreads = 1;
+    vector<float> reference;
+    UvMapStats stats;
+    double luMs;
+    if(!BenchMap(positions, indices, "lu", options, reference, stats, luMs)) {
+        return 1;
+    }
+    printf("%-12s %8d %12d %12.1f %12.1f %12.2f %12s\n", "lu", 1, (int)stats.factorNonZeros,
+           stats.factorizeMilliseconds, luMs, 1.0, "-");
+
+    options.solver = UV_MAP_SOLVER_CHOLESKY;
+    options.backend = "supernodal";
+    for(int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        options.numThreads = numThreads;
+        vector<float> uvs;
+        double ms;
+        if(!BenchMap(positions, indices, "supernodal", options, uvs, stats, ms)) {
+            return 1;
+        }
+        printf("%-12s %8d %12d %12.1f %12.1f %12.2f %12.3g\n", stats.backend, numThreads, (int)stats.factorNonZeros,
+               stats.factorizeMilliseconds, ms, luMs / ms, MaxDifference(uvs, reference));
+    }
+    return 0;
+}
+
+// the stages that a call reported, in order. Only the thread of the pool adds to it, and it is
+// only read once the call is done.
+void LogStage(UvMapStage stage, void* userData) {
+    ((vector<UvMapStage>*)userData)->push_back(stage);
+}
+
+// Waits until the call has started to solve, or is done.
+void WaitForSolve(const UvMapJob& job) {
+    while(job.Stage() != UV_MAP_STAGE_SOLVE && !job.Done()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Prints the check, and counts it if it failed.
+void Check(bool ok, const char* what, int& numFailed) {
+    printf("%-64s %s\n", what, ok ? "ok" : "FAILED");
+    if(!ok) {
+        numFailed++;
+    }
+}
+
+int BenchAsync(size_t numVertices) {
+    vector<float> positions;
+    vector<int> indices;
+    MakeGrid(numVertices, positions, indices);
+    const size_t numFaces = indices.size() / 3;
+    numVertices = positions.size() / 3;
+    printf("mapping a mesh of %d vertices\n", (int)numVertices);
+
+    // the solve of Conjugate Gradient takes long enough to be cancelled while it runs.
+    UvMapOptions slow;
+    slow.solver = UV_MAP_SOLVER_CONJUGATE_GRADIENT;
+    slow.preconditioner = UV_MAP_PRECONDITIONER_DIAGONAL;
+
+    vector<float> reference;
+    UvMapStats stats;
+    double ms;
+    if(!BenchMap(positions, indices, "uvMap", UvMapOptions(), reference, stats, ms)) {
+        return 1;
+    }
+
+    int numFailed = 0;
+    {
+        // every stage is reported once, in order, and Stage never goes back.
+        UvMapThreadPool pool(1);
+        vector<UvMapStage> stages;
+        UvMapOptions options;
+        options.progress = LogStage;
+        options.progressUserData = &stages;
+        vector<float> uvs(2 * numVertices);
+        UvMapJob job = uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs.data(), NULL, options, &pool);
+        bool ordered = true;
+        UvMapStage last = UV_MAP_STAGE_BUILD;
+        while(!job.Done()) {
+            const UvMapStage stage = job.Stage();
+            ordered = ordered && stage >= last;
+            last = stage;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Check(job.Wait() == UV_MAP_SUCCESS && MaxDifference(uvs, reference) == 0.0, "a call maps just like uvMap", numFailed);
+        Check(ordered && job.Stage() == UV_MAP_STAGE_SOLVE, "Stage never goes back, and ends at UV_MAP_STAGE_SOLVE", numFailed);
+        bool increasing = !stages.empty() && stages.front() == UV_MAP_STAGE_BUILD && stages.back() == UV_MAP_STAGE_SOLVE;
+        for(size_t i = 1; i < stages.size(); i++) {
+            increasing = increasing && stages[i] > stages[i - 1];
+        }
+        Check(increasing, "the progress reports every stage once, in order", numFailed);
+    }
+    {
+        // a call that waits for a thread never starts.
+        UvMapThreadPool pool(1);
+        vector<float> uvs0(2 * numVertices);
+        vector<float> uvs1(2 * numVertices);
+        vector<UvMapStage> stages;
+        UvMapOptions options;
+        options.progress = LogStage;
+        options.progressUserData = &stages;
+        UvMapJob running = uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs0.data(), NULL, UvMapOptions(), &pool);
+        UvMapJob queued = uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs1.data(), NULL, options, &pool);
+        queued.Cancel();
+        Check(running.Wait() == UV_MAP_SUCCESS, "the running call finishes", numFailed);
+        Check(queued.Wait() == UV_MAP_CANCELLED && stages.empty() && queued.Stage() == UV_MAP_STAGE_BUILD,
+              "a queued call cancelled before it starts never starts", numFailed);
+    }
+    {
+        // UvMapJob::Cancel stops a call in the middle of its iterations.
+        UvMapThreadPool pool(1);
+        vector<float> uvs(2 * numVertices);
+        UvMapJob job = uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs.data(), NULL, slow, &pool);
+        WaitForSolve(job);
+        Clock::time_point start = Clock::now();
+        job.Cancel();
+        const UvMapStatus status = job.Wait();
+        char what[96];
+        snprintf(what, sizeof(what), "UvMapJob::Cancel stops a solving call, in %.1f ms", MillisecondsSince(start));
+        Check(status == UV_MAP_CANCELLED, what, numFailed);
+    }
+    {
+        // options.cancel stops the running call and the queued one alike.
+        UvMapThreadPool pool(1);
+        std::atomic<bool> cancel(false);
+        UvMapOptions options = slow;
+        options.cancel = &cancel;
+        vector<float> uvs0(2 * numVertices);
+        vector<float> uvs1(2 * numVertices);
+        UvMapJob running = uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs0.data(), NULL, options, &pool);
+        UvMapJob queued = uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs1.data(), NULL, options, &pool);
+        WaitForSolve(running);
+        cancel.store(true);
+        Check(running.Wait() == UV_MAP_CANCELLED && queued.Wait() == UV_MAP_CANCELLED,
+              "a shared options.cancel stops the running and the queued call", numFailed);
+    }
+    {
+        // destroying a pool cancels the running call, and the calls still in its queue.
+        vector<UvMapJob> jobs;
+        vector<vector<float> > uvs(3, vector<float>(2 * numVertices));
+        {
+            UvMapThreadPool pool(1);
+            for(size_t i = 0; i < uvs.size(); i++) {
+                jobs.push_back(uvMapAsync(positions.data(), numVertices, indices.data(), numFaces, uvs[i].data(), NULL, slow, &pool));
+            }
+            WaitForSolve(jobs[0]);
+        }
+        bool cancelled = true;
+        for(size_t i = 0; i < jobs.size(); i++) {
+            cancelled = cancelled && jobs[i].Done() && jobs[i].Wait() == UV_MAP_CANCELLED;
+        }
+        Check(cancelled, "destroying a pool cancels all its calls", numFailed);
+    }
+    return numFailed > 0 ? 1 : 0;
+}
+
+void PrintHelp() {
+    printf("Usage:\n");
+    printf("auto_uv_bench build [--vertices=N] [--max-threads=T]\n");
+    printf("auto_uv_bench multigrid [--min-vertices=N] [--max-vertices=M]\n");
+    printf("auto_uv_bench mixed [--vertices=N]\n");
+    printf("auto_uv_bench supernodal [--vertices=N] [--max-threads=T]\n");
+    printf("auto_uv_bench async [--vertices=N]\n");
+}
+
+// the value of an argument like --name=value, if arg is one.
+bool ParseArgument(const string& arg, const char* name, double& value) {
+    const string prefix = string("--") + name + "=";
+    if(arg.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    value = atof(arg.c_str() + prefix.size());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        PrintHelp();
+        return 0;
+    }
+    const string bench = argv[1];
+
+    // 0 means the default of the benchmark.
+    double vertices = 0;
+    double maxThreads = 32;
+    double minVertices = 100000;
+    double maxVertices = 20000000;
+    for(int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if(!ParseArgument(arg, "vertices", vertices) &&
+           !ParseArgument(arg, "max-threads", maxThreads) &&
+           !ParseArgument(arg, "min-vertices", minVertices) &&
+           !ParseArgument(arg, "max-vertices", maxVertices)) {
+            printf("ERROR: unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if(bench == "build") {
+        return BenchBuild(vertices > 0 ? (size_t)vertices : 10000000, (int)maxThreads);
+    }
+    if(bench == "multigrid") {
+        return BenchMultigrid((size_t)minVertices, (size_t)maxVertices);
+    }
+    if(bench == "mixed") {
+        return BenchMixed(vertices > 0 ? (size_t)vertices : 1000000);
+    }
+    if(bench == "supernodal") {
+        return BenchSupernodal(vertices > 0 ? (size_t)vertices : 1200000, (int)maxThreads);
+    }
+    if(bench == "async") {
+        return BenchAsync(vertices > 0 ? (size_t)vertices : 250000);
+    }
+
+    PrintHelp();
+    return 1;
+}
@@ -0,0 +1,156 @@
+#include "uv_mapper/uv_mapper_mpi.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/*
+  UV maps an obj file with uvMapDistributed, on all the processes it is started with:
+
+  mpirun -np 4 auto_uv_mpi [--preconditioner=diagonal|ic|multigrid] input.obj output.obj
+
+  Only rank 0 reads and writes the obj files. The output has the vertices and the
+  triangles of the input, and a uv for every vertex.
+*/
+
+void LoadMesh(const string& inputfile, vector<float>& vertices, vector<int>& faces, MPI_Comm comm) {
+    using namespace std;
+
+    ifstream file(inputfile.c_str());
+
+    if(!file.is_open()){
+        printf("ERROR: could not open obj file %s\n", inputfile.c_str());
+        MPI_Abort(comm, 1);
+    }
+
+    // parse the obj file:
+    string token;
+    while(!file.eof()) {
+        token = "";
+        file >> token;
+
+        if(token == "v") { // vertex.
+            float x, y, z;
+            file >> x >> y >> z;
+            vertices.push_back(x);
+            vertices.push_back(y);
+            vertices.push_back(z);
+        }
+
+        else if(token=="f")
+        {
+            string line;
+            getline(file, line);
+
+            istringstream stream(line);
+            vector<string> faceVertices;
+            copy(istream_iterator<string>(stream),
+                 istream_iterator<string>(),
+                 back_inserter(faceVertices));
+
+            if(faceVertices.size() != 3) {
+                printf("ERROR: Found primitive with %ld vertices. But only meshes with only triangles are accepted!", faceVertices.size());
+                MPI_Abort(comm, 1);
+            }
+
+            for(size_t i=0 ; i< 3 ; ++i) {
+                string::size_type _pos = faceVertices[i].find('/', 0);
+                string _indexStr = faceVertices[i].substr(0, _pos);
+
+                faces.push_back(stoi(_indexStr)-1);
+            }
+        }
+    }
+}
+
+void SaveMesh(const string& outputfile, const vector<float>& vertices, const vector<int>& faces, const vector<float>& uvs, MPI_Comm comm) {
+    FILE* file = fopen(outputfile.c_str(), "w");
+    if(!file) {
+        printf("ERROR: could not write obj file %s\n", outputfile.c_str());
+        MPI_Abort(comm, 1);
+    }
+
+    for(size_t i = 0; i < vertices.size(); i += 3) {
+        fprintf(file, "v %f %f %f\n", vertices[i + 0], vertices[i + 1], vertices[i + 2]);
+    }
+    for(size_t i = 0; i < uvs.size(); i += 2) {
+        fprintf(file, "vt %f %f\n", uvs[i + 0], uvs[i + 1]);
+    }
+    for(size_t i = 0; i < faces.size(); i += 3) {
+        int a = faces[i + 0] + 1;
+        int b = faces[i + 1] + 1;
+        int c = faces[i + 2] + 1;
+        fprintf(file, "f %d/%d %d/%d %d/%d\n", a, a, b, b, c, c);
+    }
+    fclose(file);
+}
+
+void PrintHelp() {
+    printf("Usage:");
+    printf("auto_uv_mpi: [--preconditioner=diagonal|ic|multigrid] input output\n");
+}
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    UvMapOptions options;
+    options.solver = UV_MAP_SOLVER_CONJUGATE_GRADIENT;
+    if(argc < 3) {
+        if(rank == 0) {
+            PrintHelp();
+        }
+        MPI_Finalize();
+        return 0;
+    }
+    for(int i = 1; i < argc - 2; i++) {
+        string arg = argv[i];
+        if(arg == "--preconditioner=diagonal") {
+            options.preconditioner = UV_MAP_PRECONDITIONER_DIAGONAL;
+        } else if(arg == "--preconditioner=ic") {
+            options.preconditioner = UV_MAP_PRECONDITIONER_INCOMPLETE_CHOLESKY;
+        } else if(arg == "--preconditioner=multigrid") {
+            options.preconditioner = UV_MAP_PRECONDITIONER_MULTIGRID;
+        } else {
+            if(rank == 0) {
+                printf("ERROR: unknown argument %s\n", arg.c_str());
+            }
+            MPI_Abort(comm, 1);
+        }
+    }
+
+    // only rank 0 has the mesh.
+    vector<float> vertices;
+    vector<int> faces;
+    if(rank == 0) {
+        LoadMesh(argv[argc - 2], vertices, faces, comm);
+    }
+
+    vector<float> uvs(vertices.size() / 3 * 2);
+    UvMapStats stats;
+    const UvMapStatus status = uvMapDistributed(vertices.data(), vertices.size() / 3, faces.data(), faces.size() / 3, uvs.data(), options, comm, &stats);
+    if(status != UV_MAP_SUCCESS) {
+        if(rank == 0) {
+            printf("ERROR: %s\n", uvMapStatusMessage(status));
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    if(rank == 0) {
+        SaveMesh(argv[argc - 1], vertices, faces, uvs, comm);
+        printf("Mapped %d vertices in %d iterations, residual %g\n", (int)(vertices.size() / 3), stats.iterations, stats.residual);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
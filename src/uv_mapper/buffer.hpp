@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+//
+// Helpers for buffers that are reused from one call to the next.
+// They work just like the std::vector methods they wrap, but also
+// count every time the buffer has to grow, so that it is easy to
+// verify that reusing the buffers actually avoids allocations.
+//
+
+template<typename T>
+void ReserveBuffer(std::vector<T>& buffer, size_t size, size_t& numAllocations) {
+    if(size > buffer.capacity()) {
+        numAllocations++;
+        buffer.reserve(size);
+    }
+}
+
+template<typename T>
+void ResizeBuffer(std::vector<T>& buffer, size_t size, size_t& numAllocations) {
+    ReserveBuffer(buffer, size, numAllocations);
+    buffer.resize(size);
+}
+
+// resizes the buffer, and sets every element to value.
+template<typename T>
+void AssignBuffer(std::vector<T>& buffer, size_t size, const T& value, size_t& numAllocations) {
+    ReserveBuffer(buffer, size, numAllocations);
+    buffer.assign(size, value);
+}
+
+template<typename T>
+void PushBuffer(std::vector<T>& buffer, const T& value, size_t& numAllocations) {
+    if(buffer.size() == buffer.capacity()) {
+        numAllocations++;
+    }
+    buffer.push_back(value);
+}
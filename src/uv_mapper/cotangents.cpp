@@ -0,0 +1,160 @@
+#include "cotangents.hpp"
+
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//
+// The vertices of the face are a, b and c, and its edges, in the order of its half edges, are
+//
+// e0 = b - a, e1 = c - b, e2 = a - c
+//
+// so the angle at a is between e0 and -e2, the angle at b between -e0 and e1, and the
+// angle at c between e2 and -e1. And |cross(e0, e2)| is twice the area of the face.
+//
+// The SIMD versions do exactly the same operations in exactly the same order, so every
+// face gets the same cotangents, whichever version computes it.
+//
+
+static inline void FaceCotangent(
+    const float* px, const float* py, const float* pz, int stride, const uint32_t* faceVertices, size_t f, float* cotangents) {
+    const size_t a = stride * (size_t)faceVertices[3 * f + 0];
+    const size_t b = stride * (size_t)faceVertices[3 * f + 1];
+    const size_t c = stride * (size_t)faceVertices[3 * f + 2];
+
+    const float e0x = px[b] - px[a], e0y = py[b] - py[a], e0z = pz[b] - pz[a];
+    const float e1x = px[c] - px[b], e1y = py[c] - py[b], e1z = pz[c] - pz[b];
+    const float e2x = px[a] - px[c], e2y = py[a] - py[c], e2z = pz[a] - pz[c];
+
+    const float nx = e0y * e2z - e0z * e2y;
+    const float ny = e0z * e2x - e0x * e2z;
+    const float nz = e0x * e2y - e0y * e2x;
+    const float invArea = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+
+    const float dot01 = e0x * e1x + e0y * e1y + e0z * e1z;
+    const float dot12 = e1x * e2x + e1y * e2y + e1z * e2z;
+    const float dot20 = e2x * e0x + e2y * e0y + e2z * e0z;
+
+    // the half edge 3f+k is opposite to the vertex (k+2)%3.
+    cotangents[3 * f + 0] = -dot12 * invArea;
+    cotangents[3 * f + 1] = -dot20 * invArea;
+    cotangents[3 * f + 2] = -dot01 * invArea;
+}
+
+#if defined(__AVX2__)
+
+// the cotangents of the 8 faces starting at f.
+static inline void FaceCotangents8(
+    const float* px, const float* py, const float* pz, int stride, const uint32_t* faceVertices, size_t f, float* cotangents) {
+    const __m256i faceOffsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i strides = _mm256_set1_epi32(stride);
+    const int* vertices = (const int*)(faceVertices + 3 * f);
+
+    const __m256i a = _mm256_mullo_epi32(_mm256_i32gather_epi32(vertices + 0, faceOffsets, 4), strides);
+    const __m256i b = _mm256_mullo_epi32(_mm256_i32gather_epi32(vertices + 1, faceOffsets, 4), strides);
+    const __m256i c = _mm256_mullo_epi32(_mm256_i32gather_epi32(vertices + 2, faceOffsets, 4), strides);
+
+    const __m256 ax = _mm256_i32gather_ps(px, a, 4), ay = _mm256_i32gather_ps(py, a, 4), az = _mm256_i32gather_ps(pz, a, 4);
+    const __m256 bx = _mm256_i32gather_ps(px, b, 4), by = _mm256_i32gather_ps(py, b, 4), bz = _mm256_i32gather_ps(pz, b, 4);
+    const __m256 cx = _mm256_i32gather_ps(px, c, 4), cy = _mm256_i32gather_ps(py, c, 4), cz = _mm256_i32gather_ps(pz, c, 4);
+
+    const __m256 e0x = _mm256_sub_ps(bx, ax), e0y = _mm256_sub_ps(by, ay), e0z = _mm256_sub_ps(bz, az);
+    const __m256 e1x = _mm256_sub_ps(cx, bx), e1y = _mm256_sub_ps(cy, by), e1z = _mm256_sub_ps(cz, bz);
+    const __m256 e2x = _mm256_sub_ps(ax, cx), e2y = _mm256_sub_ps(ay, cy), e2z = _mm256_sub_ps(az, cz);
+
+    const __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e0y, e2z), _mm256_mul_ps(e0z, e2y));
+    const __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e0z, e2x), _mm256_mul_ps(e0x, e2z));
+    const __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e0x, e2y), _mm256_mul_ps(e0y, e2x));
+    const __m256 area2 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+    // negated, so the dot products below come out as cotangents.
+    const __m256 invArea = _mm256_div_ps(_mm256_set1_ps(-1.0f), area2);
+
+    #define DOT(ux, uy, uz, vx, vy, vz) \
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ux, vx), _mm256_mul_ps(uy, vy)), _mm256_mul_ps(uz, vz))
+    float cot0[8], cot1[8], cot2[8];
+    _mm256_storeu_ps(cot0, _mm256_mul_ps(DOT(e1x, e1y, e1z, e2x, e2y, e2z), invArea));
+    _mm256_storeu_ps(cot1, _mm256_mul_ps(DOT(e2x, e2y, e2z, e0x, e0y, e0z), invArea));
+    _mm256_storeu_ps(cot2, _mm256_mul_ps(DOT(e0x, e0y, e0z, e1x, e1y, e1z), invArea));
+    #undef DOT
+
+    for(int i = 0; i < 8; i++) {
+        cotangents[3 * (f + i) + 0] = cot0[i];
+        cotangents[3 * (f + i) + 1] = cot1[i];
+        cotangents[3 * (f + i) + 2] = cot2[i];
+    }
+}
+
+#elif defined(__SSE2__)
+
+// the cotangents of the 4 faces starting at f.
+static inline void FaceCotangents4(
+    const float* px, const float* py, const float* pz, int stride, const uint32_t* faceVertices, size_t f, float* cotangents) {
+    size_t a[4], b[4], c[4];
+    for(int i = 0; i < 4; i++) {
+        a[i] = stride * (size_t)faceVertices[3 * (f + i) + 0];
+        b[i] = stride * (size_t)faceVertices[3 * (f + i) + 1];
+        c[i] = stride * (size_t)faceVertices[3 * (f + i) + 2];
+    }
+
+    #define LOAD(p, v) _mm_setr_ps(p[v[0]], p[v[1]], p[v[2]], p[v[3]])
+    const __m128 ax = LOAD(px, a), ay = LOAD(py, a), az = LOAD(pz, a);
+    const __m128 bx = LOAD(px, b), by = LOAD(py, b), bz = LOAD(pz, b);
+    const __m128 cx = LOAD(px, c), cy = LOAD(py, c), cz = LOAD(pz, c);
+    #undef LOAD
+
+    const __m128 e0x = _mm_sub_ps(bx, ax), e0y = _mm_sub_ps(by, ay), e0z = _mm_sub_ps(bz, az);
+    const __m128 e1x = _mm_sub_ps(cx, bx), e1y = _mm_sub_ps(cy, by), e1z = _mm_sub_ps(cz, bz);
+    const __m128 e2x = _mm_sub_ps(ax, cx), e2y = _mm_sub_ps(ay, cy), e2z = _mm_sub_ps(az, cz);
+
+    const __m128 nx = _mm_sub_ps(_mm_mul_ps(e0y, e2z), _mm_mul_ps(e0z, e2y));
+    const __m128 ny = _mm_sub_ps(_mm_mul_ps(e0z, e2x), _mm_mul_ps(e0x, e2z));
+    const __m128 nz = _mm_sub_ps(_mm_mul_ps(e0x, e2y), _mm_mul_ps(e0y, e2x));
+    const __m128 area2 = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+    // negated, so the dot products below come out as cotangents.
+    const __m128 invArea = _mm_div_ps(_mm_set1_ps(-1.0f), area2);
+
+    #define DOT(ux, uy, uz, vx, vy, vz) \
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(ux, vx), _mm_mul_ps(uy, vy)), _mm_mul_ps(uz, vz))
+    float cot0[4], cot1[4], cot2[4];
+    _mm_storeu_ps(cot0, _mm_mul_ps(DOT(e1x, e1y, e1z, e2x, e2y, e2z), invArea));
+    _mm_storeu_ps(cot1, _mm_mul_ps(DOT(e2x, e2y, e2z, e0x, e0y, e0z), invArea));
+    _mm_storeu_ps(cot2, _mm_mul_ps(DOT(e0x, e0y, e0z, e1x, e1y, e1z), invArea));
+    #undef DOT
+
+    for(int i = 0; i < 4; i++) {
+        cotangents[3 * (f + i) + 0] = cot0[i];
+        cotangents[3 * (f + i) + 1] = cot1[i];
+        cotangents[3 * (f + i) + 2] = cot2[i];
+    }
+}
+
+#endif
+
+void FaceCotangents(
+    const float* px,
+    const float* py,
+    const float* pz,
+    int stride,
+    const uint32_t* faceVertices,
+    size_t beginFace,
+    size_t endFace,
+    float* cotangents) {
+
+    size_t f = beginFace;
+#if defined(__AVX2__)
+    for(; f + 8 <= endFace; f += 8) {
+        FaceCotangents8(px, py, pz, stride, faceVertices, f, cotangents);
+    }
+#elif defined(__SSE2__)
+    for(; f + 4 <= endFace; f += 4) {
+        FaceCotangents4(px, py, pz, stride, faceVertices, f, cotangents);
+    }
+#endif
+    for(; f < endFace; f++) {
+        FaceCotangent(px, py, pz, stride, faceVertices, f, cotangents);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Computes the cotangents of the three angles of every triangle in [beginFace, endFace).
+//
+// The cotangent of the angle between the edges e1 and e2 is
+//
+// cot = cos / sin = dot(e1, e2) / |cross(e1, e2)|
+//
+// and |cross(e1, e2)| is twice the area of the triangle for all three angles, so every
+// triangle only needs a single square root, and no edge lengths at all.
+//
+// The vertex positions are read as structure-of-arrays: the position of vertex v is
+// (px[stride*v], py[stride*v], pz[stride*v]). So stride is 1 for separate x, y and z arrays,
+// and 3 for packed xyz-triples, with py = px + 1 and pz = px + 2.
+// The vertices of face f are faceVertices[3*f+0], faceVertices[3*f+1] and faceVertices[3*f+2].
+//
+// cotangents[3*f+k] receives the cotangent of the angle opposite to the half edge 3*f+k,
+// that is, the angle at faceVertices[3*f+(k+2)%3].
+//
+// Eight triangles are computed at a time with AVX2, if the file is built with AVX2,
+// otherwise four at a time with SSE2, or one at a time without either.
+//
+void FaceCotangents(
+    const float* px,
+    const float* py,
+    const float* pz,
+    int stride,
+    const uint32_t* faceVertices,
+    size_t beginFace,
+    size_t endFace,
+    float* cotangents);
@@ -0,0 +1,43 @@
+#include "direct_solver.hpp"
+#include "supernodal_cholesky.hpp"
+
+#include <string.h>
+
+#ifdef AUTO_UV_USE_CHOLMOD
+
+#include "Eigen/CholmodSupport"
+
+class CholmodSolver : public SparseDirectSolver {
+public:
+    const char* Name() const { return "cholmod"; }
+
+    void analyzePattern(const SparseMatrix& A) { llt.analyzePattern(A); }
+    void factorize(const SparseMatrix& A) { llt.factorize(A); }
+    Eigen::ComputationInfo info() const { return llt.info(); }
+
+    void Solve(const double* B, double* X, int K) {
+        const int M = llt.rows();
+        Eigen::MatrixXd::MapType(X, M, K) = llt.solve(Eigen::MatrixXd::ConstMapType(B, M, K));
+    }
+
+    // CHOLMOD counts the non-zeros of L when it analyzes the pattern.
+    size_t FactorNonZeros() const { return (size_t)llt.cholmod().lnz; }
+
+private:
+    // cholmod() is not const, though it only gives access to the counts.
+    mutable Eigen::CholmodSupernodalLLT<SparseMatrix, Eigen::Lower> llt;
+};
+
+#endif
+
+std::unique_ptr<SparseDirectSolver> CreateSparseDirectSolver(const char* name) {
+    if(strcmp(name, "supernodal") == 0) {
+        return std::unique_ptr<SparseDirectSolver>(new SupernodalCholesky());
+    }
+#ifdef AUTO_UV_USE_CHOLMOD
+    if(strcmp(name, "cholmod") == 0) {
+        return std::unique_ptr<SparseDirectSolver>(new CholmodSolver());
+    }
+#endif
+    return std::unique_ptr<SparseDirectSolver>();
+}
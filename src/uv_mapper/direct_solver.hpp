@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include "linear_solvers.hpp"
+
+//
+// A sparse direct solver for symmetric positive definite matrices, behind an interface, so
+// that solvers from other libraries can be built in optionally, and picked by name at runtime.
+//
+// analyzePattern, factorize and info are the interface of an Eigen solver, so the symbolic
+// analysis can be reused just like with the Eigen solvers.
+//
+class SparseDirectSolver {
+public:
+    virtual ~SparseDirectSolver() {}
+
+    // the name the solver is created by.
+    virtual const char* Name() const = 0;
+
+    // the number of threads to factorize with, for the solvers that control it themselves.
+    virtual void SetNumThreads(int /*numThreads*/) {}
+
+    virtual void analyzePattern(const SparseMatrix& A) = 0;
+    virtual void factorize(const SparseMatrix& A) = 0;
+    virtual Eigen::ComputationInfo info() const = 0;
+
+    // Solves A * X = B, where B and X are column-major M x K matrices.
+    virtual void Solve(const double* B, double* X, int K) = 0;
+
+    // the number of non-zeros in the factor.
+    virtual size_t FactorNonZeros() const = 0;
+};
+
+// Creates the solver with the name. Returns null if this build has no solver with the name.
+//
+// "supernodal": SupernodalCholesky, which is always built in.
+//
+// "cholmod": the supernodal Cholesky factorization of CHOLMOD, which runs on
+// several threads through a multithreaded BLAS. Needs the AUTO_UV_CHOLMOD CMake option.
+//
+std::unique_ptr<SparseDirectSolver> CreateSparseDirectSolver(const char* name);
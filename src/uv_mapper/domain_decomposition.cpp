@@ -0,0 +1,410 @@
+#include "domain_decomposition.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using std::vector;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// an element of a matrix, and where its value comes from.
+struct PatternEntry {
+    int col;
+    int row;
+    int slot;
+
+    bool operator<(const PatternEntry& other) const {
+        return col != other.col ? col < other.col : row < other.row;
+    }
+};
+
+// Builds M, with zero values, from the elements, which must all be different.
+// slots receives the slots of the elements in the order of the values of M.
+static void BuildPattern(int rows, int cols, vector<PatternEntry>& entries, SparseMatrix& M, vector<int>& slots) {
+    std::sort(entries.begin(), entries.end());
+    M.resize(rows, cols);
+    M.resizeNonZeros(entries.size());
+    slots.resize(entries.size());
+    int* outer = M.outerIndexPtr();
+    std::fill(outer, outer + cols + 1, 0);
+    for(size_t e = 0; e < entries.size(); e++) {
+        outer[entries[e].col + 1]++;
+        M.innerIndexPtr()[e] = entries[e].row;
+        M.valuePtr()[e] = 0.0;
+        slots[e] = entries[e].slot;
+    }
+    for(int j = 0; j < cols; j++) {
+        outer[j + 1] += outer[j];
+    }
+}
+
+// where in the values of M the element (row, col) is. It must be in the pattern.
+static int FindSlot(const SparseMatrix& M, int row, int col) {
+    const int* begin = M.innerIndexPtr() + M.outerIndexPtr()[col];
+    const int* end = M.innerIndexPtr() + M.outerIndexPtr()[col + 1];
+    return std::lower_bound(begin, end, row) - M.innerIndexPtr();
+}
+
+DomainDecomposition::DomainDecomposition() :
+    maxSubdomains(1),
+    numThreads(1),
+    n(0),
+    status(Eigen::InvalidInput),
+    subdomainMilliseconds(0.0),
+    schurMilliseconds(0.0) {
+}
+
+DomainDecomposition::~DomainDecomposition() {
+}
+
+int DomainDecomposition::SmallestSubdomain() const {
+    int smallest = 0;
+    for(size_t i = 0; i < subdomains.size(); i++) {
+        const int size = subdomains[i]->unknowns.size();
+        smallest = i == 0 ? size : std::min(smallest, size);
+    }
+    return smallest;
+}
+
+int DomainDecomposition::LargestSubdomain() const {
+    int largest = 0;
+    for(size_t i = 0; i < subdomains.size(); i++) {
+        largest = std::max(largest, (int)subdomains[i]->unknowns.size());
+    }
+    return largest;
+}
+
+size_t DomainDecomposition::FactorNonZeros() const {
+    size_t nonZeros = separator.empty() ? 0 : schurCholesky.FactorNonZeros();
+    for(size_t i = 0; i < subdomains.size(); i++) {
+        nonZeros += subdomains[i]->ldlt.matrixL().nestedExpression().nonZeros() + subdomains[i]->unknowns.size();
+    }
+    return nonZeros;
+}
+
+void DomainDecomposition::analyzePattern(const SparseMatrix& A) {
+    n = A.cols();
+    status = Eigen::InvalidInput;
+    const int* outer = A.outerIndexPtr();
+    const int* inner = A.innerIndexPtr();
+
+    vector<int> part(n);
+    const int numSubdomains = PartitionGraph(n, outer, inner, maxSubdomains, part.data());
+
+    // the index of every row of A in its subdomain, or in the separator.
+    vector<int> local(n);
+    separator.clear();
+    subdomains.resize(numSubdomains);
+    for(int i = 0; i < numSubdomains; i++) {
+        subdomains[i].reset(new Subdomain());
+    }
+    for(int v = 0; v < n; v++) {
+        if(part[v] == -1) {
+            local[v] = separator.size();
+            separator.push_back(v);
+        } else {
+            local[v] = subdomains[part[v]]->unknowns.size();
+            subdomains[part[v]]->unknowns.push_back(v);
+        }
+    }
+    const int numSeparator = separator.size();
+
+    // A_i, C_i and the separators each subdomain is coupled to. mark is the last subdomain that
+    // found the separator vertex, and position its index among the separator vertices of that subdomain.
+    vector<int> mark(numSeparator, -1);
+    vector<int> position(numSeparator);
+    vector<PatternEntry> entries;
+    vector<PatternEntry> couplings;
+    vector<int> order;
+    vector<int> unknowns;
+    for(int i = 0; i < numSubdomains; i++) {
+        Subdomain& subdomain = *subdomains[i];
+        const int size = subdomain.unknowns.size();
+
+        // the first pass finds the pattern of A_i for its ordering, the second one
+        // finds A_i and C_i in that order.
+        subdomain.separator.clear();
+        for(int pass = 0; pass < 2; pass++) {
+            entries.clear();
+            couplings.clear();
+            for(int c = 0; c < size; c++) {
+                const int v = subdomain.unknowns[c];
+                for(int p = outer[v]; p < outer[v + 1]; p++) {
+                    const int r = inner[p];
+                    if(part[r] == i) {
+                        PatternEntry entry = { c, local[r], p };
+                        entries.push_back(entry);
+                    } else if(pass == 1) {
+                        PatternEntry entry = { local[r], c, p };
+                        couplings.push_back(entry);
+                        if(mark[local[r]] != i) {
+                            mark[local[r]] = i;
+                            subdomain.separator.push_back(local[r]);
+                        }
+                    }
+                }
+            }
+            BuildPattern(size, size, entries, subdomain.A, subdomain.aSlots);
+            if(pass == 1) {
+                break;
+            }
+
+            // nested dissection, and then the unknowns coupled to the separators moved to the end.
+            // C_i only has rows for those.
+            order.resize(size);
+            NestedDissection(size, subdomain.A.outerIndexPtr(), subdomain.A.innerIndexPtr(), order.data());
+            vector<int>::iterator coupled = std::stable_partition(order.begin(), order.end(), [&](int c) {
+                const int v = subdomain.unknowns[c];
+                for(int p = outer[v]; p < outer[v + 1]; p++) {
+                    if(part[inner[p]] != i) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            subdomain.numInterior = coupled - order.begin();
+            unknowns.resize(size);
+            for(int c = 0; c < size; c++) {
+                unknowns[c] = subdomain.unknowns[order[c]];
+                local[unknowns[c]] = c;
+            }
+            subdomain.unknowns.swap(unknowns);
+        }
+
+        std::sort(subdomain.separator.begin(), subdomain.separator.end());
+        for(size_t s = 0; s < subdomain.separator.size(); s++) {
+            position[subdomain.separator[s]] = s;
+        }
+        for(size_t e = 0; e < couplings.size(); e++) {
+            couplings[e].col = position[couplings[e].col];
+        }
+        BuildPattern(size, subdomain.separator.size(), couplings, subdomain.C, subdomain.cSlots);
+    }
+
+    // S has the pattern of A_S, and a dense block for the separator vertices of every subdomain.
+    entries.clear();
+    for(int s = 0; s < numSeparator; s++) {
+        const int v = separator[s];
+        for(int p = outer[v]; p < outer[v + 1]; p++) {
+            if(part[inner[p]] == -1) {
+                PatternEntry entry = { s, local[inner[p]], p };
+                entries.push_back(entry);
+            }
+        }
+    }
+    vector<PatternEntry> schurEntries(entries);
+    for(int i = 0; i < numSubdomains; i++) {
+        const vector<int>& coupled = subdomains[i]->separator;
+        for(size_t b = 0; b < coupled.size(); b++) {
+            for(size_t a = 0; a < coupled.size(); a++) {
+                PatternEntry entry = { coupled[b], coupled[a], -1 };
+                schurEntries.push_back(entry);
+            }
+        }
+    }
+    std::sort(schurEntries.begin(), schurEntries.end());
+    size_t numUnique = 0;
+    for(size_t e = 0; e < schurEntries.size(); e++) {
+        if(numUnique == 0 || schurEntries[numUnique - 1] < schurEntries[e]) {
+            schurEntries[numUnique++] = schurEntries[e];
+        }
+    }
+    schurEntries.resize(numUnique);
+    vector<int> unused;
+    BuildPattern(numSeparator, numSeparator, schurEntries, schur, unused);
+
+    std::sort(entries.begin(), entries.end());
+    separatorSlots.resize(entries.size());
+    separatorSchurSlots.resize(entries.size());
+    for(size_t e = 0; e < entries.size(); e++) {
+        separatorSlots[e] = entries[e].slot;
+        separatorSchurSlots[e] = FindSlot(schur, entries[e].row, entries[e].col);
+    }
+    for(int i = 0; i < numSubdomains; i++) {
+        Subdomain& subdomain = *subdomains[i];
+        const vector<int>& coupled = subdomain.separator;
+        const size_t m = coupled.size();
+        subdomain.schurSlots.resize(m * m);
+        for(size_t b = 0; b < m; b++) {
+            for(size_t a = 0; a < m; a++) {
+                subdomain.schurSlots[a + b * m] = FindSlot(schur, coupled[a], coupled[b]);
+            }
+        }
+    }
+
+    ParallelFor(0, numSubdomains, numThreads, 1, [&](size_t begin, size_t end, int) {
+        for(size_t i = begin; i < end; i++) {
+            subdomains[i]->ldlt.analyzePattern(subdomains[i]->A);
+        }
+    });
+    if(numSeparator > 0) {
+        schurCholesky.analyzePattern(schur);
+    }
+    status = Eigen::Success;
+}
+
+// Factorizes A_i, and computes C_i^T * A_i^-1 * C_i. Returns false if A_i is not positive definite.
+bool DomainDecomposition::FactorizeSubdomain(Subdomain& subdomain, const SparseMatrix& A) {
+    const double* values = A.valuePtr();
+    for(size_t e = 0; e < subdomain.aSlots.size(); e++) {
+        subdomain.A.valuePtr()[e] = values[subdomain.aSlots[e]];
+    }
+    for(size_t e = 0; e < subdomain.cSlots.size(); e++) {
+        subdomain.C.valuePtr()[e] = values[subdomain.cSlots[e]];
+    }
+
+    subdomain.ldlt.factorize(subdomain.A);
+    if(subdomain.ldlt.info() != Eigen::Success || subdomain.ldlt.vectorD().minCoeff() <= 0.0) {
+        return false;
+    }
+
+    // Z = L_i^-1 * C_i is zero above the unknowns coupled to the separators, and below them only
+    // depends on the trailing block of L_i, so that is solved with as a dense triangular matrix.
+    const int begin = subdomain.numInterior;
+    const int numInterface = subdomain.unknowns.size() - begin;
+    const int m = subdomain.separator.size();
+    const SparseMatrix& L = subdomain.ldlt.matrixL().nestedExpression();
+    Eigen::MatrixXd trailingL = Eigen::MatrixXd::Zero(numInterface, numInterface);
+    for(int j = 0; j < numInterface; j++) {
+        for(SparseMatrix::InnerIterator it(L, begin + j); it; ++it) {
+            trailingL(it.row() - begin, j) = it.value();
+        }
+    }
+    Eigen::MatrixXd Z = Eigen::MatrixXd::Zero(numInterface, m);
+    for(int j = 0; j < m; j++) {
+        for(SparseMatrix::InnerIterator it(subdomain.C, j); it; ++it) {
+            Z(it.row() - begin, j) = it.value();
+        }
+    }
+    trailingL.triangularView<Eigen::UnitLower>().solveInPlace(Z);
+
+    const Eigen::VectorXd inverseD = subdomain.ldlt.vectorD().tail(numInterface).cwiseInverse();
+    const Eigen::MatrixXd scaledZ = inverseD.asDiagonal() * Z;
+    subdomain.schurPart.resize(m, m);
+    subdomain.schurPart.noalias() = Z.transpose() * scaledZ;
+    return true;
+}
+
+void DomainDecomposition::factorize(const SparseMatrix& A) {
+    Clock::time_point start = Clock::now();
+    const int numSubdomains = subdomains.size();
+    vector<char> factorized(numSubdomains);
+    ParallelFor(0, numSubdomains, numThreads, 1, [&](size_t begin, size_t end, int) {
+        for(size_t i = begin; i < end; i++) {
+            factorized[i] = FactorizeSubdomain(*subdomains[i], A);
+        }
+    });
+    subdomainMilliseconds = MillisecondsSince(start);
+    schurMilliseconds = 0.0;
+    if(std::find(factorized.begin(), factorized.end(), 0) != factorized.end()) {
+        status = Eigen::NumericalIssue;
+        return;
+    }
+
+    start = Clock::now();
+    if(!separator.empty()) {
+        double* schurValues = schur.valuePtr();
+        std::fill(schurValues, schurValues + schur.nonZeros(), 0.0);
+        for(size_t e = 0; e < separatorSlots.size(); e++) {
+            schurValues[separatorSchurSlots[e]] += A.valuePtr()[separatorSlots[e]];
+        }
+        for(int i = 0; i < numSubdomains; i++) {
+            const Subdomain& subdomain = *subdomains[i];
+            const double* part = subdomain.schurPart.data();
+            for(size_t e = 0; e < subdomain.schurSlots.size(); e++) {
+                schurValues[subdomain.schurSlots[e]] -= part[e];
+            }
+        }
+
+        schurCholesky.SetNumThreads(numThreads);
+        schurCholesky.factorize(schur);
+        if(schurCholesky.info() != Eigen::Success) {
+            status = Eigen::NumericalIssue;
+            return;
+        }
+    }
+    schurMilliseconds = MillisecondsSince(start);
+    status = Eigen::Success;
+}
+
+void DomainDecomposition::Solve(const double* B, double* X, int K) {
+    const int numSubdomains = subdomains.size();
+    const int numSeparator = separator.size();
+
+    // the right hand side of the separators, minus C_i^T * A_i^-1 * B_i of every subdomain.
+    Eigen::MatrixXd separatorX(numSeparator, K);
+    for(int c = 0; c < K; c++) {
+        for(int s = 0; s < numSeparator; s++) {
+            separatorX(s, c) = B[(size_t)c * n + separator[s]];
+        }
+    }
+    vector<Eigen::MatrixXd> eliminated(numSubdomains);
+    ParallelFor(0, numSubdomains, numThreads, 1, [&](size_t begin, size_t end, int) {
+        Eigen::MatrixXd Y;
+        Eigen::MatrixXd work;
+        for(size_t i = begin; i < end; i++) {
+            const Subdomain& subdomain = *subdomains[i];
+            const int size = subdomain.unknowns.size();
+            Y.resize(size, K);
+            work.resize(size, K);
+            for(int c = 0; c < K; c++) {
+                for(int r = 0; r < size; r++) {
+                    Y(r, c) = B[(size_t)c * n + subdomain.unknowns[r]];
+                }
+            }
+            SolveLdltBlocked(subdomain.ldlt, Y.data(), Y.data(), K, work.data());
+            eliminated[i].noalias() = subdomain.C.transpose() * Y;
+        }
+    });
+    for(int i = 0; i < numSubdomains; i++) {
+        const vector<int>& coupled = subdomains[i]->separator;
+        for(size_t s = 0; s < coupled.size(); s++) {
+            separatorX.row(coupled[s]) -= eliminated[i].row(s);
+        }
+    }
+
+    if(numSeparator > 0) {
+        schurCholesky.Solve(separatorX.data(), separatorX.data(), K);
+    }
+
+    // every subdomain then solves A_i * X_i = B_i - C_i * X_S.
+    ParallelFor(0, numSubdomains, numThreads, 1, [&](size_t begin, size_t end, int) {
+        Eigen::MatrixXd Y;
+        Eigen::MatrixXd coupledX;
+        Eigen::MatrixXd work;
+        for(size_t i = begin; i < end; i++) {
+            const Subdomain& subdomain = *subdomains[i];
+            const int size = subdomain.unknowns.size();
+            const int m = subdomain.separator.size();
+            Y.resize(size, K);
+            work.resize(size, K);
+            coupledX.resize(m, K);
+            for(int c = 0; c < K; c++) {
+                for(int r = 0; r < size; r++) {
+                    Y(r, c) = B[(size_t)c * n + subdomain.unknowns[r]];
+                }
+            }
+            for(int s = 0; s < m; s++) {
+                coupledX.row(s) = separatorX.row(subdomain.separator[s]);
+            }
+            Y.noalias() -= subdomain.C * coupledX;
+            SolveLdltBlocked(subdomain.ldlt, Y.data(), Y.data(), K, work.data());
+            for(int c = 0; c < K; c++) {
+                for(int r = 0; r < size; r++) {
+                    X[(size_t)c * n + subdomain.unknowns[r]] = Y(r, c);
+                }
+            }
+        }
+    });
+
+    for(int c = 0; c < K; c++) {
+        for(int s = 0; s < numSeparator; s++) {
+            X[(size_t)c * n + separator[s]] = separatorX(s, c);
+        }
+    }
+}
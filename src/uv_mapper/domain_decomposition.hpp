@@ -0,0 +1,111 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "linear_solvers.hpp"
+#include "nested_dissection.hpp"
+#include "supernodal_cholesky.hpp"
+
+//
+// Solves a symmetric positive definite system by domain decomposition.
+//
+// analyzePattern partitions the graph of A into subdomains, with separators between them (see
+// PartitionGraph), so that after reordering A as the subdomains and then the separators,
+//
+//   [ A_1             C_1 ]
+//   [      ...        ... ]
+//   [           A_k   C_k ]
+//   [ C_1^T ... C_k^T A_S ]
+//
+// the subdomains are only coupled through the separators. factorize then factorizes every A_i
+// on its own, in parallel, together with its part C_i^T * A_i^-1 * C_i of the Schur complement
+//
+//   S = A_S - sum_i C_i^T * A_i^-1 * C_i
+//
+// and factorizes S, which only has a row for every separator vertex, and so is far smaller than A.
+// S is made of the dense blocks of the subdomains, so it is factorized by SupernodalCholesky.
+// Every subdomain is ordered by nested dissection, but with the unknowns that are coupled to the
+// separators last. Then C_i only has rows in the trailing block of the factor L_i * D_i * L_i^T of A_i,
+// and its part of S is Z^T * D_i^-1 * Z, with Z = L_i^-1 * C_i, from that dense block alone.
+// Solve eliminates the subdomains from the right hand side in parallel, solves with S for the
+// separators, and then back substitutes into the subdomains in parallel.
+//
+// The parts of S are added up in the order of the subdomains, so the result only depends on
+// the number of subdomains, not on the number of threads.
+//
+class DomainDecomposition {
+public:
+    DomainDecomposition();
+    ~DomainDecomposition();
+
+    // the number of subdomains to partition into, for the next analyzePattern.
+    void SetNumSubdomains(int numSubdomains) { maxSubdomains = numSubdomains; }
+    int MaxSubdomains() const { return maxSubdomains; }
+
+    void SetNumThreads(int numThreads) { this->numThreads = numThreads; }
+
+    // A must be in compressed mode.
+    void analyzePattern(const SparseMatrix& A);
+    void factorize(const SparseMatrix& A);
+    Eigen::ComputationInfo info() const { return status; }
+
+    // Solves A * X = B, where B and X are column-major n x K matrices.
+    void Solve(const double* B, double* X, int K);
+
+    // the partition: the number of subdomains it found, the number of unknowns on the
+    // separators, and in the smallest and the largest subdomain.
+    int NumSubdomains() const { return subdomains.size(); }
+    int SeparatorSize() const { return separator.size(); }
+    int SmallestSubdomain() const;
+    int LargestSubdomain() const;
+
+    // the time the last factorize took for the subdomains, and for the Schur complement.
+    double SubdomainMilliseconds() const { return subdomainMilliseconds; }
+    double SchurMilliseconds() const { return schurMilliseconds; }
+
+    // the number of non-zeros in the factors of the subdomains and of the Schur complement.
+    size_t FactorNonZeros() const;
+
+private:
+    DomainDecomposition(const DomainDecomposition&);
+    DomainDecomposition& operator=(const DomainDecomposition&);
+
+    // the subdomains are already in their elimination order.
+    typedef Eigen::SimplicialLDLT<SparseMatrix, Eigen::Lower, Eigen::NaturalOrdering<int> > SubdomainLdlt;
+
+    struct Subdomain {
+        std::vector<int> unknowns; // its rows of A, in elimination order.
+        int numInterior; // the unknowns after these are coupled to the separators.
+        std::vector<int> separator; // the separator vertices it is coupled to, as indices into separator.
+
+        // A_i and C_i, and where in the values of A their elements are.
+        SparseMatrix A;
+        SparseMatrix C;
+        std::vector<int> aSlots;
+        std::vector<int> cSlots;
+        SubdomainLdlt ldlt;
+
+        // C_i^T * A_i^-1 * C_i, and where in the values of S every element of it goes.
+        Eigen::MatrixXd schurPart;
+        std::vector<int> schurSlots;
+    };
+
+    bool FactorizeSubdomain(Subdomain& subdomain, const SparseMatrix& A);
+
+    int maxSubdomains;
+    int numThreads;
+    int n;
+    Eigen::ComputationInfo status;
+
+    std::vector< std::unique_ptr<Subdomain> > subdomains;
+    std::vector<int> separator; // the rows of A on the separators.
+
+    // S, and where the elements of A_S go in it.
+    SparseMatrix schur;
+    std::vector<int> separatorSlots; // in the values of A.
+    std::vector<int> separatorSchurSlots; // in the values of S.
+    SupernodalCholesky schurCholesky;
+
+    double subdomainMilliseconds;
+    double schurMilliseconds;
+};
@@ -4,6 +4,7 @@
 #include <set>
 #include <vector>
 
+#include <stdio.h>
 #include <stdlib.h>
 
 using std::vector;
@@ -0,0 +1,530 @@
+#include "indexed_half_edge_mesh.hpp"
+#include "parallel.hpp"
+#include "buffer.hpp"
+
+#include <atomic>
+#include <vector>
+
+#include <stdlib.h>
+
+using std::vector;
+
+// number of bits needed to store the value n.
+static int NumBits(uint64_t n) {
+    int bits = 0;
+    while(n > 0) {
+        n >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+//
+// Sorts the (key, value) pairs by key with an LSD radix sort, processing
+// RADIX_BITS bits of the key per pass. The sort is stable, so pairs with equal
+// keys keep the order they had in the input. Only the lowest keyBits bits of the
+// keys are considered. The scratch arrays must be as large as keys and values.
+//
+// Every pass is split into chunks that are processed in parallel: each chunk
+// counts its digits, and then scatters its pairs to offsets computed from all the
+// counts, chunk after chunk within every bucket. So the output is exactly that
+// of the serial sort, whatever the number of threads.
+//
+static const int RADIX_BITS = 11;
+static const int RADIX_BUCKETS = 1 << RADIX_BITS;
+
+// below this, it is not worth starting a thread.
+static const size_t MIN_CHUNK_SIZE = 1 << 16;
+
+static void RadixSort(
+    vector<uint64_t>& keys,
+    vector<uint32_t>& values,
+    vector<uint64_t>& scratchKeys,
+    vector<uint32_t>& scratchValues,
+    vector<size_t>& offsets,
+    int keyBits,
+    int numThreads,
+    size_t& numAllocations) {
+
+    const size_t n = keys.size();
+    const int numChunks = NumChunks(0, n, numThreads, MIN_CHUNK_SIZE);
+
+    // offsets[chunk * RADIX_BUCKETS + digit]
+    ResizeBuffer(offsets, numChunks * RADIX_BUCKETS, numAllocations);
+
+    for(int shift = 0; shift < keyBits; shift += RADIX_BITS) {
+        const uint64_t* in = keys.data();
+        const uint32_t* inValues = values.data();
+        uint64_t* out = scratchKeys.data();
+        uint32_t* outValues = scratchValues.data();
+        size_t* chunkOffsets = offsets.data();
+
+        // histogram of the digits in this pass, per chunk.
+        ParallelFor(0, n, numThreads, MIN_CHUNK_SIZE, [=](size_t begin, size_t end, int chunk) {
+            size_t* histogram = chunkOffsets + chunk * RADIX_BUCKETS;
+            for(int b = 0; b < RADIX_BUCKETS; b++) {
+                histogram[b] = 0;
+            }
+            for(size_t i = begin; i < end; i++) {
+                histogram[(in[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+            }
+        });
+
+        // turn the histograms into output offsets.
+        size_t sum = 0;
+        for(int b = 0; b < RADIX_BUCKETS; b++) {
+            for(int chunk = 0; chunk < numChunks; chunk++) {
+                size_t count = offsets[chunk * RADIX_BUCKETS + b];
+                offsets[chunk * RADIX_BUCKETS + b] = sum;
+                sum += count;
+            }
+        }
+
+        // scatter.
+        ParallelFor(0, n, numThreads, MIN_CHUNK_SIZE, [=](size_t begin, size_t end, int chunk) {
+            size_t* offset = chunkOffsets + chunk * RADIX_BUCKETS;
+            for(size_t i = begin; i < end; i++) {
+                size_t dst = offset[(in[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+                out[dst] = in[i];
+                outValues[dst] = inValues[i];
+            }
+        });
+
+        keys.swap(scratchKeys);
+        values.swap(scratchValues);
+    }
+}
+
+// the vector constructor reads vec3 and Tri as plain arrays.
+static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 must be three packed floats");
+static_assert(sizeof(Tri) == 3 * sizeof(int), "Tri must be three packed ints");
+
+IndexedHalfEdgeMesh::IndexedHalfEdgeMesh(
+    const vector<vec3>& vertices,
+    const vector<Tri>& faces,
+    int numThreads) :
+    IndexedHalfEdgeMesh(
+        vertices.empty() ? NULL : &vertices[0].x, vertices.size(),
+        faces.empty() ? NULL : faces[0].i, faces.size(),
+        numThreads) {
+}
+
+IndexedHalfEdgeMesh::IndexedHalfEdgeMesh(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+    int numThreads) :
+    vertexAtomicsSize(0),
+    numAllocations(0) {
+
+    Build(positions, numVertices, indices, numFaces, numThreads);
+}
+
+IndexedHalfEdgeMesh::IndexedHalfEdgeMesh() :
+    vertexAtomicsSize(0),
+    numAllocations(0) {
+}
+
+bool IndexedHalfEdgeMesh::Build(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+    int numThreads) {
+
+    const size_t numHalfEdges = numFaces * 3;
+
+    for(size_t i = 0; i < numHalfEdges; i++) {
+        if(indices[i] < 0 || (size_t)indices[i] >= numVertices) {
+            return false;
+        }
+    }
+
+    ResizeBuffer(heNext, numHalfEdges, numAllocations);
+    AssignBuffer(heTwin, numHalfEdges, INVALID_INDEX, numAllocations); // twin is null by default.
+    ResizeBuffer(heVertex, numHalfEdges, numAllocations);
+    ResizeBuffer(heFace, numHalfEdges, numAllocations);
+    ResizeBuffer(heEdge, numHalfEdges, numAllocations);
+
+    AssignBuffer(vertexHalfEdge, numVertices, INVALID_INDEX, numAllocations);
+    ResizeBuffer(px, numVertices, numAllocations);
+    ResizeBuffer(py, numVertices, numAllocations);
+    ResizeBuffer(pz, numVertices, numAllocations);
+    ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(size_t i = begin; i < end; i++) {
+            px[i] = positions[3 * i + 0];
+            py[i] = positions[3 * i + 1];
+            pz[i] = positions[3 * i + 2];
+        }
+    });
+
+    // the half edges of a face are simply the three consecutive
+    // slots starting at 3*face.
+    ParallelFor(0, numFaces, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(FaceIndex face = begin; face < end; face++) {
+            for(int iTri = 0; iTri < 3; iTri++) {
+                HalfEdgeIndex halfEdge = 3 * face + iTri;
+
+                heNext[halfEdge] = 3 * face + (iTri+1)%3;
+                heFace[halfEdge] = face;
+                heVertex[halfEdge] = indices[halfEdge];
+            }
+        }
+    });
+
+    // every vertex gets the last half edge that emanates from it. Several
+    // chunks may share a vertex, so with more than one chunk we take the
+    // maximum with atomics, which gives the same result as the serial loop.
+    if(NumChunks(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE) == 1) {
+        for(HalfEdgeIndex halfEdge = 0; halfEdge < numHalfEdges; halfEdge++) {
+            vertexHalfEdge[heVertex[halfEdge]] = halfEdge;
+        }
+    } else {
+        std::atomic<uint32_t>* lastHalfEdge = VertexAtomics(numVertices);
+        ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+            for(size_t i = begin; i < end; i++) {
+                lastHalfEdge[i].store(INVALID_INDEX, std::memory_order_relaxed);
+            }
+        });
+        ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+            for(HalfEdgeIndex halfEdge = begin; halfEdge < end; halfEdge++) {
+                std::atomic<uint32_t>& last = lastHalfEdge[heVertex[halfEdge]];
+                uint32_t current = last.load(std::memory_order_relaxed);
+                while((current == INVALID_INDEX || current < halfEdge) &&
+                      !last.compare_exchange_weak(current, halfEdge, std::memory_order_relaxed)) {
+                }
+            }
+        });
+        ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+            for(size_t i = begin; i < end; i++) {
+                vertexHalfEdge[i] = lastHalfEdge[i].load(std::memory_order_relaxed);
+            }
+        });
+    }
+
+    //
+    // Now we find the twins. Every half edge gets a key made by packing the
+    // sorted indices of its two vertices into a 64-bit integer, and then all
+    // half edges are sorted by that key. After that, the half edges of an edge
+    // sit right next to each other, so they can be linked in one linear pass.
+    //
+    const int vertexBits = NumBits(numVertices > 0 ? numVertices - 1 : 0);
+
+    vector<uint64_t>& keys = sortKeys;
+    vector<uint32_t>& order = sortOrder;
+    ResizeBuffer(keys, numHalfEdges, numAllocations);
+    ResizeBuffer(order, numHalfEdges, numAllocations);
+    ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(HalfEdgeIndex halfEdge = begin; halfEdge < end; halfEdge++) {
+            uint64_t i0 = heVertex[halfEdge];
+            uint64_t i1 = heVertex[heNext[halfEdge]];
+            keys[halfEdge] = i0 < i1 ? ((i0 << vertexBits) | i1) : ((i1 << vertexBits) | i0);
+            order[halfEdge] = halfEdge;
+        }
+    });
+
+    ResizeBuffer(sortScratchKeys, numHalfEdges, numAllocations);
+    ResizeBuffer(sortScratchOrder, numHalfEdges, numAllocations);
+    RadixSort(
+        keys, order, sortScratchKeys, sortScratchOrder, sortOffsets,
+        2 * vertexBits, numThreads, numAllocations);
+
+    // the half edges are linked in chunks of the sorted keys. Chunks are
+    // moved forward so that they start at a new key, so that every group of
+    // equal keys is handled by exactly one chunk. Every chunk remembers the
+    // first duplicated half edge it found.
+    const int numChunks = NumChunks(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE);
+    vector<HalfEdgeIndex>& duplicatedHalfEdge = chunkHalfEdge;
+    AssignBuffer(duplicatedHalfEdge, numChunks, INVALID_INDEX, numAllocations);
+
+    ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t chunkBegin, size_t chunkEnd, int chunk) {
+        while(chunkBegin > 0 && chunkBegin < numHalfEdges && keys[chunkBegin] == keys[chunkBegin - 1]) {
+            chunkBegin++;
+        }
+
+        for(size_t begin = chunkBegin; begin < chunkEnd;) {
+            size_t end = begin + 1;
+            while(end < numHalfEdges && keys[end] == keys[begin]) {
+                end++;
+            }
+
+            if(end - begin >= 2) {
+                HalfEdgeIndex he0 = order[begin];
+                HalfEdgeIndex he1 = order[begin + 1];
+
+                // an edge shared by more than two faces always repeats one of
+                // its two directions, and so does a pair with the same direction.
+                if(end - begin > 2 || heVertex[he0] == heVertex[he1]) {
+                    duplicatedHalfEdge[chunk] = heVertex[he0] == heVertex[he1] ? he0 : order[begin + 2];
+                    return;
+                }
+
+                heTwin[he0] = he1;
+                heTwin[he1] = he0;
+            }
+
+            begin = end;
+        }
+    });
+
+    for(int chunk = 0; chunk < numChunks; chunk++) {
+        HalfEdgeIndex duplicated = duplicatedHalfEdge[chunk];
+        if(duplicated != INVALID_INDEX) {
+            return false;
+        }
+    }
+
+    //
+    // Finally, create the edges. Every edge is numbered by the first of its
+    // half edges, so the numbering does not depend on the sort. The chunks
+    // count their edges first, so that they know where their numbering starts.
+    //
+    vector<size_t>& firstEdge = chunkFirstEdge;
+    AssignBuffer(firstEdge, numChunks + 1, (size_t)0, numAllocations);
+    ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int chunk) {
+        size_t count = 0;
+        for(HalfEdgeIndex halfEdge = begin; halfEdge < end; halfEdge++) {
+            if(heTwin[halfEdge] == INVALID_INDEX || halfEdge < heTwin[halfEdge]) {
+                count++;
+            }
+        }
+        firstEdge[chunk + 1] = count;
+    });
+    for(int chunk = 0; chunk < numChunks; chunk++) {
+        firstEdge[chunk + 1] += firstEdge[chunk];
+    }
+
+    ResizeBuffer(edgeHalfEdge, firstEdge[numChunks], numAllocations);
+    ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int chunk) {
+        EdgeIndex edge = firstEdge[chunk];
+        for(HalfEdgeIndex halfEdge = begin; halfEdge < end; halfEdge++) {
+            if(heTwin[halfEdge] == INVALID_INDEX || halfEdge < heTwin[halfEdge]) {
+                edgeHalfEdge[edge] = halfEdge;
+                heEdge[halfEdge] = edge;
+                edge++;
+            }
+        }
+    });
+
+    // the other half edge of every edge, which may be in another chunk.
+    ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(HalfEdgeIndex halfEdge = begin; halfEdge < end; halfEdge++) {
+            HalfEdgeIndex twin = heTwin[halfEdge];
+            if(twin != INVALID_INDEX && twin < halfEdge) {
+                heEdge[halfEdge] = heEdge[twin];
+            }
+        }
+    });
+
+    if(!FindBoundaryLoops(numThreads)) {
+        return false;
+    }
+    FindVertexEdges(numThreads);
+    return true;
+}
+
+std::atomic<uint32_t>* IndexedHalfEdgeMesh::VertexAtomics(size_t numVertices) {
+    if(numVertices > vertexAtomicsSize) {
+        numAllocations++;
+        vertexAtomics.reset(new std::atomic<uint32_t>[numVertices]);
+        vertexAtomicsSize = numVertices;
+    }
+    return vertexAtomics.get();
+}
+
+void IndexedHalfEdgeMesh::FindVertexEdges(int numThreads) {
+    const size_t numVertices = NumVertices();
+    const size_t numEdges = NumEdges();
+
+    AssignBuffer(vertexEdgeOffsets, numVertices + 1, (uint32_t)0, numAllocations);
+    ResizeBuffer(vertexEdges, 2 * numEdges, numAllocations);
+
+    //
+    // A counting sort of the edges by their vertices: count the edges of every
+    // vertex, and then put every edge right into the ranges of its two vertices.
+    // Several chunks may share a vertex, so with more than one chunk we count
+    // with atomics. Then the edges of a vertex end up in any order, so every
+    // range is sorted at the end, which gives the same result as the serial loop.
+    //
+    if(NumChunks(0, numEdges, numThreads, MIN_CHUNK_SIZE) == 1) {
+        for(EdgeIndex edge = 0; edge < numEdges; edge++) {
+            vertexEdgeOffsets[Vertex(edgeHalfEdge[edge]) + 1]++;
+            vertexEdgeOffsets[Vertex(Next(edgeHalfEdge[edge])) + 1]++;
+        }
+        for(size_t i = 0; i < numVertices; i++) {
+            vertexEdgeOffsets[i + 1] += vertexEdgeOffsets[i];
+        }
+
+        // vertexEdgeOffsets[i] is where the next edge of vertex i goes, and
+        // ends up as the start of vertex i + 1.
+        for(EdgeIndex edge = 0; edge < numEdges; edge++) {
+            vertexEdges[vertexEdgeOffsets[Vertex(edgeHalfEdge[edge])]++] = edge;
+            vertexEdges[vertexEdgeOffsets[Vertex(Next(edgeHalfEdge[edge]))]++] = edge;
+        }
+        for(size_t i = numVertices; i > 0; i--) {
+            vertexEdgeOffsets[i] = vertexEdgeOffsets[i - 1];
+        }
+        vertexEdgeOffsets[0] = 0;
+        return;
+    }
+
+    std::atomic<uint32_t>* cursor = VertexAtomics(numVertices);
+    ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(size_t i = begin; i < end; i++) {
+            cursor[i].store(0, std::memory_order_relaxed);
+        }
+    });
+    ParallelFor(0, numEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(EdgeIndex edge = begin; edge < end; edge++) {
+            cursor[Vertex(edgeHalfEdge[edge])].fetch_add(1, std::memory_order_relaxed);
+            cursor[Vertex(Next(edgeHalfEdge[edge]))].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    for(size_t i = 0; i < numVertices; i++) {
+        vertexEdgeOffsets[i + 1] = vertexEdgeOffsets[i] + cursor[i].load(std::memory_order_relaxed);
+    }
+
+    ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(size_t i = begin; i < end; i++) {
+            cursor[i].store(vertexEdgeOffsets[i], std::memory_order_relaxed);
+        }
+    });
+    ParallelFor(0, numEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(EdgeIndex edge = begin; edge < end; edge++) {
+            vertexEdges[cursor[Vertex(edgeHalfEdge[edge])].fetch_add(1, std::memory_order_relaxed)] = edge;
+            vertexEdges[cursor[Vertex(Next(edgeHalfEdge[edge]))].fetch_add(1, std::memory_order_relaxed)] = edge;
+        }
+    });
+
+    // a vertex only has a handful of edges, so insertion sort is fine.
+    ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(size_t i = begin; i < end; i++) {
+            EdgeIndex* edges = vertexEdges.data() + vertexEdgeOffsets[i];
+            const uint32_t count = vertexEdgeOffsets[i + 1] - vertexEdgeOffsets[i];
+            for(uint32_t j = 1; j < count; j++) {
+                EdgeIndex edge = edges[j];
+                uint32_t k = j;
+                while(k > 0 && edges[k - 1] > edge) {
+                    edges[k] = edges[k - 1];
+                    k--;
+                }
+                edges[k] = edge;
+            }
+        }
+    });
+}
+
+bool IndexedHalfEdgeMesh::FindBoundaryLoops(int numThreads) {
+    const size_t numHalfEdges = NumHalfEdges();
+
+    AssignBuffer(heBoundaryNext, numHalfEdges, INVALID_INDEX, numAllocations);
+    AssignBuffer(heBoundaryLoop, numHalfEdges, INVALID_INDEX, numAllocations);
+
+    //
+    // The next boundary half edge emanates from the vertex that the
+    // boundary half edge points to. We find it by rotating around that
+    // vertex, starting in the face of the boundary half edge, until we
+    // hit the boundary again.
+    //
+    const int numChunks = NumChunks(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE);
+    vector<HalfEdgeIndex>& brokenHalfEdge = chunkHalfEdge;
+    AssignBuffer(brokenHalfEdge, numChunks, INVALID_INDEX, numAllocations);
+
+    ParallelFor(0, numHalfEdges, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int chunk) {
+        for(HalfEdgeIndex he = begin; he < end; he++) {
+            if(!IsBoundaryHalfEdge(he)) {
+                continue;
+            }
+
+            HalfEdgeIndex first = Next(he);
+            HalfEdgeIndex halfEdge = first;
+            while(!IsBoundaryHalfEdge(halfEdge)) {
+                halfEdge = Next(Twin(halfEdge));
+
+                if(halfEdge == first) { // went all the way around.
+                    brokenHalfEdge[chunk] = he;
+                    return;
+                }
+            }
+
+            heBoundaryNext[he] = halfEdge;
+        }
+    });
+
+    for(int chunk = 0; chunk < numChunks; chunk++) {
+        if(brokenHalfEdge[chunk] != INVALID_INDEX) {
+            return false;
+        }
+    }
+
+    //
+    // Then, follow the links to collect the loops.
+    //
+    loopHalfEdge.clear();
+    loopLength.clear();
+
+    for(HalfEdgeIndex first = 0; first < numHalfEdges; first++) {
+        if(!IsBoundaryHalfEdge(first) || heBoundaryLoop[first] != INVALID_INDEX) {
+            continue;
+        }
+
+        const uint32_t loop = loopHalfEdge.size();
+        uint32_t length = 0;
+
+        HalfEdgeIndex halfEdge = first;
+        do {
+            // two boundary half edges that lead to the same one.
+            if(heBoundaryLoop[halfEdge] != INVALID_INDEX) {
+                return false;
+            }
+
+            heBoundaryLoop[halfEdge] = loop;
+            length++;
+            halfEdge = heBoundaryNext[halfEdge];
+        } while(halfEdge != first);
+
+        PushBuffer(loopHalfEdge, first, numAllocations);
+        PushBuffer(loopLength, length, numAllocations);
+    }
+    return true;
+}
+
+void IndexedHalfEdgeMesh::ToMesh(
+    std::vector<vec3>& vertices,
+    std::vector<Tri>& faces,
+    std::vector<VertexIndex>* vertexMap) const {
+
+    // new index of every vertex, assigned the first time a face visits it.
+    vector<uint32_t> newIndex(NumVertices(), INVALID_INDEX);
+    uint32_t numNewVertices = 0;
+
+    for(FaceIndex face = 0; face < NumFaces(); face++) {
+        HalfEdgeIndex halfEdge = FaceHalfEdge(face);
+
+        for(int i = 0; i < 3; i++) {
+            VertexIndex v = Vertex(halfEdge);
+
+            if(newIndex[v] == INVALID_INDEX) {
+                newIndex[v] = numNewVertices++;
+                vertices.push_back(Position(v));
+                if(vertexMap) {
+                    vertexMap->push_back(v);
+                }
+            }
+            halfEdge = Next(halfEdge);
+        }
+
+        // like HalfEdgeMesh, start the face at its last half edge, so the faces are
+        // output with the same vertex order as before.
+        Tri tri;
+        halfEdge = Next(Next(FaceHalfEdge(face)));
+        for(int i = 0; i < 3; i++) {
+            tri.i[i] = newIndex[Vertex(halfEdge)];
+            halfEdge = Next(halfEdge);
+        }
+
+        faces.push_back(tri);
+    }
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "vec.hpp"
+
+//
+// This is a half-edge mesh implementation based on contiguous arrays of
+// 32-bit indices.
+//
+// Unlike HalfEdgeMesh, which links list nodes together with iterators, every
+// half edge, edge, vertex and face is here simply an index into a handful of
+// flat arrays. So a traversal like next->twin->vertex is three array lookups,
+// and the whole mesh takes a few dozen bytes per vertex.
+//
+// The three half edges of face f are always stored at 3*f, 3*f+1 and 3*f+2,
+// and vertex i is the i:th vertex of the input mesh. Vertices that are not
+// referenced by any face are kept, but have no half edge.
+//
+
+typedef uint32_t HalfEdgeIndex;
+typedef uint32_t EdgeIndex;
+typedef uint32_t VertexIndex;
+typedef uint32_t FaceIndex;
+
+// plays the role that EndHalfEdges() plays for the list-based mesh.
+const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+class IndexedHalfEdgeMesh {
+public:
+    // An empty mesh, to be filled in by Build.
+    IndexedHalfEdgeMesh();
+
+    // The mesh is built by numThreads threads. The resulting mesh is
+    // the same regardless of the number of threads.
+    IndexedHalfEdgeMesh(
+        const std::vector<vec3>& vertices,
+        const std::vector<Tri>& faces,
+        int numThreads = 1);
+
+    // Same as above, but reads the mesh straight from the arrays
+    // positions (xyz for each of the numVertices vertices) and
+    // indices (three vertex indices for each of the numFaces triangles).
+    IndexedHalfEdgeMesh(
+        const float* positions,
+        size_t numVertices,
+        const int* indices,
+        size_t numFaces,
+        int numThreads = 1);
+
+    // Rebuilds the mesh from the arrays, just like the constructor does.
+    // The memory of the previous mesh is reused, so rebuilding the mesh from
+    // a mesh of the same size or smaller allocates nothing. Returns false
+    // if the faces do not make a valid mesh, which is then left incomplete.
+    bool Build(
+        const float* positions,
+        size_t numVertices,
+        const int* indices,
+        size_t numFaces,
+        int numThreads = 1);
+
+    // The number of times any buffer of the mesh has had to grow.
+    size_t NumAllocations() const { return numAllocations; }
+
+    // Convert a half edge mesh back to a polygon-soup mesh.
+    // Only vertices referenced by a face are output, in the order they are
+    // first visited by the faces. If vertexMap is non-null, vertexMap[i] is
+    // the index in this mesh of output vertex i.
+    void ToMesh(
+        std::vector<vec3>& vertices,
+        std::vector<Tri>& faces,
+        std::vector<VertexIndex>* vertexMap) const;
+
+    bool IsBoundaryHalfEdge(HalfEdgeIndex he) const { return heTwin[he] == INVALID_INDEX; }
+    bool IsBoundaryEdge(EdgeIndex e) const { return IsBoundaryHalfEdge(edgeHalfEdge[e]); }
+
+    //
+    // Boundary loops. These are all found when the mesh is built, so
+    // walking along a boundary is a single lookup per step.
+    //
+
+    // the boundary half edge that follows the boundary half edge he.
+    HalfEdgeIndex GetNextBoundary(HalfEdgeIndex he) const { return heBoundaryNext[he]; }
+    // the loop that the boundary half edge he is part of. INVALID_INDEX if he is not on the boundary.
+    uint32_t BoundaryLoop(HalfEdgeIndex he) const { return heBoundaryLoop[he]; }
+
+    size_t NumBoundaryLoops() const { return loopHalfEdge.size(); }
+    // one of the half edges of the loop.
+    HalfEdgeIndex BoundaryLoopHalfEdge(uint32_t loop) const { return loopHalfEdge[loop]; }
+    // the number of half edges in the loop.
+    uint32_t BoundaryLoopLength(uint32_t loop) const { return loopLength[loop]; }
+
+    //
+    // The edges around every vertex. Also found when the mesh is built.
+    //
+
+    // the edges that vertex v is an endpoint of, sorted by index.
+    const EdgeIndex* VertexEdgesBegin(VertexIndex v) const { return vertexEdges.data() + vertexEdgeOffsets[v]; }
+    const EdgeIndex* VertexEdgesEnd(VertexIndex v) const { return vertexEdges.data() + vertexEdgeOffsets[v + 1]; }
+    // the number of edges of vertex v.
+    uint32_t Valence(VertexIndex v) const { return vertexEdgeOffsets[v + 1] - vertexEdgeOffsets[v]; }
+
+    //
+    // Traversal.
+    //
+
+    // the half edge that this half edge is pointing at, in the current face.
+    HalfEdgeIndex Next(HalfEdgeIndex he) const { return heNext[he]; }
+    // the half edge opposite to this half edge. INVALID_INDEX on the boundary.
+    HalfEdgeIndex Twin(HalfEdgeIndex he) const { return heTwin[he]; }
+    // the vertex at the root of this half edge.
+    VertexIndex Vertex(HalfEdgeIndex he) const { return heVertex[he]; }
+    FaceIndex Face(HalfEdgeIndex he) const { return heFace[he]; }
+    EdgeIndex Edge(HalfEdgeIndex he) const { return heEdge[he]; }
+
+    // one of the two half edges this edge is split into.
+    HalfEdgeIndex EdgeHalfEdge(EdgeIndex e) const { return edgeHalfEdge[e]; }
+    // one of the half edges emanating from this vertex. INVALID_INDEX if isolated.
+    HalfEdgeIndex VertexHalfEdge(VertexIndex v) const { return vertexHalfEdge[v]; }
+    HalfEdgeIndex FaceHalfEdge(FaceIndex f) const { return 3 * f; }
+
+    vec3 Position(VertexIndex v) const { return vec3(px[v], py[v], pz[v]); }
+
+    float GetLength(HalfEdgeIndex he) const {
+        return vec3::distance(Position(Vertex(he)), Position(Vertex(Next(he))));
+    }
+    float GetEdgeLength(EdgeIndex e) const { return GetLength(edgeHalfEdge[e]); }
+
+    // the vertex positions, as structure-of-arrays.
+    const float* PositionsX() const { return px.data(); }
+    const float* PositionsY() const { return py.data(); }
+    const float* PositionsZ() const { return pz.data(); }
+
+    // the vertices of every face, three per face, which is also Vertex(he) for every half edge.
+    const VertexIndex* FaceVertices() const { return heVertex.data(); }
+
+    size_t NumVertices() const { return px.size(); }
+    size_t NumEdges() const { return edgeHalfEdge.size(); }
+    size_t NumHalfEdges() const { return heNext.size(); }
+    size_t NumFaces() const { return heNext.size() / 3; }
+
+private:
+
+    bool FindBoundaryLoops(int numThreads);
+    void FindVertexEdges(int numThreads);
+
+    // scratch atomics, one per vertex, grown to numVertices if needed.
+    std::atomic<uint32_t>* VertexAtomics(size_t numVertices);
+
+    // per half edge.
+    std::vector<HalfEdgeIndex> heNext;
+    std::vector<HalfEdgeIndex> heTwin;
+    std::vector<VertexIndex> heVertex;
+    std::vector<FaceIndex> heFace;
+    std::vector<EdgeIndex> heEdge;
+
+    // per half edge, but only used for boundary half edges.
+    std::vector<HalfEdgeIndex> heBoundaryNext;
+    std::vector<uint32_t> heBoundaryLoop;
+
+    // per edge.
+    std::vector<HalfEdgeIndex> edgeHalfEdge;
+
+    // per boundary loop.
+    std::vector<HalfEdgeIndex> loopHalfEdge;
+    std::vector<uint32_t> loopLength;
+
+    // per vertex.
+    std::vector<HalfEdgeIndex> vertexHalfEdge;
+    std::vector<uint32_t> vertexEdgeOffsets; // one more than the vertices.
+    std::vector<float> px;
+    std::vector<float> py;
+    std::vector<float> pz;
+
+    // the edges of every vertex, from vertexEdgeOffsets[v] to vertexEdgeOffsets[v+1].
+    std::vector<EdgeIndex> vertexEdges;
+
+    //
+    // Scratch memory for Build, kept so that it can be reused.
+    //
+    std::vector<uint64_t> sortKeys;
+    std::vector<uint32_t> sortOrder;
+    std::vector<uint64_t> sortScratchKeys;
+    std::vector<uint32_t> sortScratchOrder;
+    std::vector<size_t> sortOffsets;
+    std::vector<HalfEdgeIndex> chunkHalfEdge;
+    std::vector<size_t> chunkFirstEdge;
+    std::unique_ptr< std::atomic<uint32_t>[] > vertexAtomics;
+    size_t vertexAtomicsSize;
+
+    size_t numAllocations;
+};
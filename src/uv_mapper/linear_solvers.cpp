@@ -0,0 +1,133 @@
+#include "linear_solvers.hpp"
+
+// 64-bit FNV-1a.
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t HashInts(uint64_t hash, const int* values, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        uint32_t v = (uint32_t)values[i];
+        for(int b = 0; b < 4; b++) {
+            hash ^= (v >> (8 * b)) & 0xFF;
+            hash *= FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+uint64_t SparsityPatternHash(const SparseMatrix& A) {
+    int size[3] = { (int)A.rows(), (int)A.cols(), (int)A.nonZeros() };
+    uint64_t hash = HashInts(FNV_OFFSET, size, 3);
+    // an uncompressed matrix has gaps between the columns, so they are hashed one by one.
+    for(int j = 0; j < A.outerSize(); j++) {
+        const int begin = A.outerIndexPtr()[j];
+        const int n = A.isCompressed() ? A.outerIndexPtr()[j + 1] - begin : A.innerNonZeroPtr()[j];
+        hash = HashInts(hash, &n, 1);
+        hash = HashInts(hash, A.innerIndexPtr() + begin, n);
+    }
+    return hash;
+}
+
+// With K known at compile time, the loops over the columns are unrolled and
+// vectorized. K = 0 means that the number of columns is only known at runtime.
+template<int K, typename Scalar>
+static void SolveLdltBlocked(
+    const Eigen::SparseMatrix<Scalar>& L,
+    const Scalar* D,
+    const int* P,
+    const Scalar* B,
+    Scalar* X,
+    int numColumns,
+    Scalar* work) {
+
+    const int k = K > 0 ? K : numColumns;
+    const int M = L.rows();
+
+    const int* Lp = L.outerIndexPtr();
+    const int* Li = L.innerIndexPtr();
+    const Scalar* Lx = L.valuePtr();
+
+    // work = P * B, stored row by row, so that the k values of row i are
+    // next to each other.
+    for(int i = 0; i < M; i++) {
+        for(int c = 0; c < k; c++) {
+            work[(P ? P[i] : i) * k + c] = B[c * M + i];
+        }
+    }
+
+    // solve L * Y = work. L has a unit diagonal, and only the
+    // strictly lower part is stored, column by column.
+    for(int j = 0; j < M; j++) {
+        const Scalar* wj = work + j * k;
+        for(int p = Lp[j]; p < Lp[j + 1]; p++) {
+            Scalar* wi = work + Li[p] * k;
+            for(int c = 0; c < k; c++) {
+                wi[c] -= Lx[p] * wj[c];
+            }
+        }
+    }
+
+    for(int j = 0; j < M; j++) {
+        for(int c = 0; c < k; c++) {
+            work[j * k + c] /= D[j];
+        }
+    }
+
+    // solve L^T * Z = Y. Column j of L is row j of L^T.
+    for(int j = M - 1; j >= 0; j--) {
+        Scalar* wj = work + j * k;
+        for(int p = Lp[j]; p < Lp[j + 1]; p++) {
+            const Scalar* wi = work + Li[p] * k;
+            for(int c = 0; c < k; c++) {
+                wj[c] -= Lx[p] * wi[c];
+            }
+        }
+    }
+
+    // X = P^-1 * work.
+    for(int i = 0; i < M; i++) {
+        for(int c = 0; c < k; c++) {
+            X[c * M + i] = work[(P ? P[i] : i) * k + c];
+        }
+    }
+}
+
+template<typename Scalar>
+static void SolveLdltBlockedK(
+    const Eigen::SparseMatrix<Scalar>& L,
+    const Scalar* D,
+    const int* P,
+    const Scalar* B,
+    Scalar* X,
+    int K,
+    Scalar* work) {
+
+    switch(K) {
+    case 1: SolveLdltBlocked<1>(L, D, P, B, X, K, work); break;
+    case 2: SolveLdltBlocked<2>(L, D, P, B, X, K, work); break;
+    case 4: SolveLdltBlocked<4>(L, D, P, B, X, K, work); break;
+    default: SolveLdltBlocked<0>(L, D, P, B, X, K, work); break;
+    }
+}
+
+void SolveLdltBlocked(
+    const SparseMatrix& L,
+    const double* D,
+    const int* P,
+    const double* B,
+    double* X,
+    int K,
+    double* work) {
+    SolveLdltBlockedK(L, D, P, B, X, K, work);
+}
+
+void SolveLdltBlocked(
+    const SparseMatrixF& L,
+    const float* D,
+    const int* P,
+    const float* B,
+    float* X,
+    int K,
+    float* work) {
+    SolveLdltBlockedK(L, D, P, B, X, K, work);
+}
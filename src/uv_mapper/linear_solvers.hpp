@@ -0,0 +1,153 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include "Eigen/Sparse"
+
+//
+// Helpers for solving the sparse linear systems of the uv mapper.
+//
+
+typedef Eigen::SparseMatrix<double> SparseMatrix;
+// single precision, for the mixed precision solver.
+typedef Eigen::SparseMatrix<float> SparseMatrixF;
+
+//
+// Eigen's orderings do not agree on which way their permutation goes. AMDOrdering and
+// MetisOrdering give the column to eliminate k-th as perm[k], which is what SimplicialLDLT
+// expects, while COLAMDOrdering gives the position of column j as perm[j], which is what
+// SparseLU expects. With the other solver, each ordering does far worse than no ordering
+// at all, so this flips the permutation of an ordering, to use it with the other solver.
+//
+template<typename Ordering>
+class InverseOrdering {
+public:
+    typedef Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> PermutationType;
+
+    template<typename MatrixType>
+    void operator()(const MatrixType& mat, PermutationType& perm) {
+        PermutationType forward;
+        Ordering ordering;
+        ordering(mat, forward);
+        perm = forward.inverse();
+    }
+};
+
+// A 64-bit hash of the sparsity pattern of A, that is, of everything but the values.
+// The symbolic analysis of a factorization only depends on the pattern, so it can be reused
+// for any matrix with the same hash.
+uint64_t SparsityPatternHash(const SparseMatrix& A);
+
+// Solves A * X = B from the parts of the LDL^T factorization of A: the strictly lower
+// part of L, the diagonal D, and the permutation P, which may be null. See below.
+void SolveLdltBlocked(
+    const SparseMatrix& L,
+    const double* D,
+    const int* P,
+    const double* B,
+    double* X,
+    int K,
+    double* work);
+
+void SolveLdltBlocked(
+    const SparseMatrixF& L,
+    const float* D,
+    const int* P,
+    const float* B,
+    float* X,
+    int K,
+    float* work);
+
+//
+// Solves A * X = B with the LDL^T factorization of A, for all the K columns of B at once.
+//
+// Eigen solves one column at a time, which means streaming all of L from
+// memory twice for every column. Here, every element of L is instead loaded
+// once, and then applied to all K columns, in the forward as well as the backward
+// substitution.
+//
+// B and X are column-major M x K matrices, and work must have room for M*K elements.
+// B and X may be the same array. Works with any SimplicialLDLT, in double or single
+// precision, whatever its ordering.
+//
+template<typename Ldlt>
+void SolveLdltBlocked(
+    const Ldlt& ldlt,
+    const typename Ldlt::Scalar* B,
+    typename Ldlt::Scalar* X,
+    int K,
+    typename Ldlt::Scalar* work) {
+
+    // vectorD returns a copy, so it has to be kept alive while it is used.
+    const Eigen::Matrix<typename Ldlt::Scalar, Eigen::Dynamic, 1> diag = ldlt.vectorD();
+    // without a fill-reducing ordering, there is no permutation.
+    const int* P = ldlt.permutationP().size() > 0 ? ldlt.permutationP().indices().data() : NULL;
+    SolveLdltBlocked(ldlt.matrixL().nestedExpression(), diag.data(), P, B, X, K, work);
+}
+
+//
+// Solves A * x = b with the iterations of Eigen::ConjugateGradient, and the preconditioner of
+// one, starting from x, until the residual |A*x - b| / |b| is below tolerance, or for at most
+// maxIterations iterations, or until cancelled() returns true, which it is asked before every
+// iteration. Eigen's solver can only be stopped by giving it fewer iterations, and then every
+// run starts its search directions over, which on the Laplacian of the uv mapper takes up to
+// twice as many iterations in all.
+//
+// A is stored in full. iterations and error receive the number of iterations and the final
+// residual, just like from Eigen. Returns whether the residual is below tolerance.
+//
+template<typename Preconditioner, typename Cancelled>
+bool SolveConjugateGradient(
+    const SparseMatrix& A,
+    const Preconditioner& preconditioner,
+    const double* b,
+    double* x,
+    double tolerance,
+    int maxIterations,
+    Cancelled cancelled,
+    int& iterations,
+    double& error) {
+
+    const int n = A.cols();
+    Eigen::VectorXd::ConstMapType B(b, n);
+    Eigen::VectorXd::MapType X(x, n);
+
+    Eigen::VectorXd residual = B - A * X;
+    iterations = 0;
+    const double rhsNorm2 = B.squaredNorm();
+    if(rhsNorm2 == 0.0) {
+        X.setZero();
+        error = 0.0;
+        return true;
+    }
+    const double threshold = tolerance * tolerance * rhsNorm2;
+    double residualNorm2 = residual.squaredNorm();
+    if(residualNorm2 < threshold) {
+        error = sqrt(residualNorm2 / rhsNorm2);
+        return error <= tolerance;
+    }
+
+    Eigen::VectorXd p = preconditioner.solve(residual);
+    Eigen::VectorXd z(n);
+    Eigen::VectorXd q(n);
+    double absNew = residual.dot(p);
+    while(iterations < maxIterations && !cancelled()) {
+        q.noalias() = A * p;
+        const double alpha = absNew / p.dot(q);
+        X += alpha * p;
+        residual -= alpha * q;
+
+        residualNorm2 = residual.squaredNorm();
+        if(residualNorm2 < threshold) {
+            break;
+        }
+
+        z = preconditioner.solve(residual);
+        const double absOld = absNew;
+        absNew = residual.dot(z);
+        p = z + (absNew / absOld) * p;
+        iterations++;
+    }
+    error = sqrt(residualNorm2 / rhsNorm2);
+    return error <= tolerance;
+}
@@ -0,0 +1,302 @@
+#include "matrix_free_cg.hpp"
+#include "parallel.hpp"
+#include "buffer.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+using std::vector;
+
+// the unknowns are split into blocks of this many for the dot products. Every block is
+// added up by itself, and then the sums of the blocks in order.
+static const size_t BLOCK_SIZE = 1 << 12;
+
+// the fewest blocks a thread is given.
+static const size_t MIN_BLOCKS_PER_THREAD = 4;
+
+// the most sums ForBlocks adds up at a time.
+static const int MAX_SUMS = 4;
+
+//
+// Calls fn(begin, end, sums) for the unknowns [begin, end) of every block of the blocks
+// [blockBegin, blockEnd) of the M unknowns, which are the blocks of one thread. fn writes
+// numSums sums of its block into its sums in blockSums. Then waits for the other threads,
+// and sums receives the totals of all the blocks, added up in order by every thread, so
+// that they all get the same totals.
+//
+template<typename Function>
+static void ForBlocks(
+    int M, size_t blockBegin, size_t blockEnd, Barrier& barrier,
+    double* blockSums, int numSums, double* sums, Function fn) {
+
+    for(size_t block = blockBegin; block < blockEnd; block++) {
+        fn(block * BLOCK_SIZE, std::min((block + 1) * BLOCK_SIZE, (size_t)M), &blockSums[MAX_SUMS * block]);
+    }
+    barrier.Wait();
+
+    const size_t numBlocks = (M + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for(int s = 0; s < numSums; s++) {
+        sums[s] = 0.0;
+    }
+    for(size_t block = 0; block < numBlocks; block++) {
+        for(int s = 0; s < numSums; s++) {
+            sums[s] += blockSums[MAX_SUMS * block + s];
+        }
+    }
+}
+
+MatrixFreeConjugateGradient::MatrixFreeConjugateGradient() :
+    hem(NULL), M(0), numThreads(1), weights(NULL), numAllocations(0) {
+}
+
+void MatrixFreeConjugateGradient::Setup(const IndexedHalfEdgeMesh& hem, const uint32_t* unknownIndex, int M, int numThreads) {
+    this->hem = &hem;
+    this->M = M;
+    this->numThreads = numThreads;
+
+    ResizeBuffer(unknownVertices, M, numAllocations);
+    for(VertexIndex i = 0; i < hem.NumVertices(); i++) {
+        if(unknownIndex[i] != INVALID_INDEX) {
+            unknownVertices[unknownIndex[i]] = i;
+        }
+    }
+
+    // an edge from a vertex to itself only adds to the diagonal, so its other end counts as
+    // fixed. The boundary edges have no weight, so their unknowns do not matter.
+    const uint32_t fixed = M;
+    ResizeBuffer(edgeUnknowns, hem.NumEdges(), numAllocations);
+    ParallelFor(0, hem.NumEdges(), numThreads, BLOCK_SIZE, [&](size_t begin, size_t end, int) {
+        for(EdgeIndex e = begin; e < end; e++) {
+            const HalfEdgeIndex he = hem.EdgeHalfEdge(e);
+            const VertexIndex i0 = hem.Vertex(he);
+            const VertexIndex i1 = hem.Vertex(hem.Next(he));
+            const uint32_t u0 = unknownIndex[i0] != INVALID_INDEX ? unknownIndex[i0] : fixed;
+            const uint32_t u1 = unknownIndex[i1] != INVALID_INDEX && i1 != i0 ? unknownIndex[i1] : fixed;
+            edgeUnknowns[e] = u0 ^ u1;
+        }
+    });
+
+    ResizeBuffer(diagonal, M, numAllocations);
+    ResizeBuffer(x, 2 * M, numAllocations);
+    ResizeBuffer(r, 2 * M, numAllocations);
+    ResizeBuffer(z, 2 * M, numAllocations);
+    ResizeBuffer(p, 2 * (M + 1), numAllocations);
+    ResizeBuffer(q, 2 * M, numAllocations);
+    ResizeBuffer(blockSums, 2 * MAX_SUMS * ((M + BLOCK_SIZE - 1) / BLOCK_SIZE), numAllocations);
+}
+
+void MatrixFreeConjugateGradient::Multiply(const double* P, double* Q, size_t begin, size_t end) const {
+    for(size_t u0 = begin; u0 < end; u0++) {
+        const VertexIndex i0 = unknownVertices[u0];
+        double sum0 = diagonal[u0] * P[2 * u0 + 0];
+        double sum1 = diagonal[u0] * P[2 * u0 + 1];
+        // the fixed neighbours read the zeros at M.
+        for(const EdgeIndex* e = hem->VertexEdgesBegin(i0); e != hem->VertexEdgesEnd(i0); e++) {
+            const uint32_t u1 = edgeUnknowns[*e] ^ (uint32_t)u0;
+            const double weight = weights[*e];
+            sum0 -= weight * P[2 * u1 + 0];
+            sum1 -= weight * P[2 * u1 + 1];
+        }
+        Q[2 * u0 + 0] = sum0;
+        Q[2 * u0 + 1] = sum1;
+    }
+}
+
+//
+// These are the steps of Eigen::ConjugateGradient with the diagonal preconditioner, for both
+// columns at once, and with the vector operations of every step fused into a single pass over
+// the unknowns. A column that has converged is left as it is, while the other one goes on.
+//
+// The threads are started once, and every thread takes the same blocks in every step. They
+// wait for each other at the end of every step, and then all compute the same scalars of the
+// iteration from the sums of the blocks, so nothing runs on a single thread in between.
+//
+bool MatrixFreeConjugateGradient::Solve(
+    const double* B, double* X, double tolerance, int maxIterations,
+    std::chrono::steady_clock::time_point deadline, const std::function<bool()>& cancelled,
+    int& iterations, double& residual) {
+
+    for(int i = 0; i < M; i++) {
+        p[2 * i + 0] = X[i];
+        p[2 * i + 1] = X[M + i];
+    }
+    p[2 * M + 0] = 0.0;
+    p[2 * M + 1] = 0.0;
+
+    const size_t numBlocks = (M + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    Barrier barrier(NumChunks(0, numBlocks, numThreads, MIN_BLOCKS_PER_THREAD));
+
+    // the sums of the blocks of two steps in a row, so that a thread can go on to the next
+    // step while the others are still adding up the sums of the last one.
+    double* stepSums[2] = { blockSums.data(), blockSums.data() + MAX_SUMS * numBlocks };
+
+    // whether the deadline has passed, or the call has been cancelled. Only the first thread
+    // looks, during the last step of every iteration, so that all the threads stop after the
+    // same iteration.
+    bool stop = std::chrono::steady_clock::now() >= deadline || cancelled();
+    bool converged = false;
+
+    ParallelFor(0, numBlocks, numThreads, MIN_BLOCKS_PER_THREAD, [&](size_t blockBegin, size_t blockEnd, int chunk) {
+        bool active[2];
+        double rhsNorm2[2];
+        double residualNorm2[2];
+        double threshold[2];
+        double absNew[2];
+        double alpha[2];
+        double beta[2];
+        int columnIterations[2] = { 0, 0 };
+        double sums[MAX_SUMS];
+        int step = 0;
+
+        // r = b - W * x
+        ForBlocks(M, blockBegin, blockEnd, barrier, stepSums[step++ & 1], 4, sums, [&](size_t begin, size_t end, double* blockSum) {
+            Multiply(p.data(), q.data(), begin, end);
+            double bb0 = 0.0, bb1 = 0.0, rr0 = 0.0, rr1 = 0.0;
+            for(size_t i = begin; i < end; i++) {
+                x[2 * i + 0] = p[2 * i + 0];
+                x[2 * i + 1] = p[2 * i + 1];
+                r[2 * i + 0] = B[i] - q[2 * i + 0];
+                r[2 * i + 1] = B[M + i] - q[2 * i + 1];
+                bb0 += B[i] * B[i];
+                bb1 += B[M + i] * B[M + i];
+                rr0 += r[2 * i + 0] * r[2 * i + 0];
+                rr1 += r[2 * i + 1] * r[2 * i + 1];
+            }
+            blockSum[0] = bb0;
+            blockSum[1] = bb1;
+            blockSum[2] = rr0;
+            blockSum[3] = rr1;
+        });
+        for(int c = 0; c < 2; c++) {
+            rhsNorm2[c] = sums[c];
+            residualNorm2[c] = sums[2 + c];
+            threshold[c] = std::max(tolerance * tolerance * rhsNorm2[c], (double)std::numeric_limits<double>::min());
+            active[c] = rhsNorm2[c] > 0.0 && residualNorm2[c] >= threshold[c];
+
+            // the solution of a zero right hand side is zero.
+            if(rhsNorm2[c] == 0.0) {
+                residualNorm2[c] = 0.0;
+            }
+        }
+
+        // z = M^-1 * r, p = z
+        ForBlocks(M, blockBegin, blockEnd, barrier, stepSums[step++ & 1], 2, sums, [&](size_t begin, size_t end, double* blockSum) {
+            double rz0 = 0.0, rz1 = 0.0;
+            for(size_t i = begin; i < end; i++) {
+                for(int c = 0; c < 2; c++) {
+                    if(rhsNorm2[c] == 0.0) {
+                        x[2 * i + c] = 0.0;
+                    }
+                }
+                const double inverse = diagonal[i] != 0.0 ? 1.0 / diagonal[i] : 1.0;
+                z[2 * i + 0] = inverse * r[2 * i + 0];
+                z[2 * i + 1] = inverse * r[2 * i + 1];
+                p[2 * i + 0] = z[2 * i + 0];
+                p[2 * i + 1] = z[2 * i + 1];
+                rz0 += r[2 * i + 0] * z[2 * i + 0];
+                rz1 += r[2 * i + 1] * z[2 * i + 1];
+            }
+            blockSum[0] = rz0;
+            blockSum[1] = rz1;
+        });
+        absNew[0] = sums[0];
+        absNew[1] = sums[1];
+
+        int iteration = 0;
+        while((active[0] || active[1]) && iteration < maxIterations && !stop) {
+            // q = W * p
+            ForBlocks(M, blockBegin, blockEnd, barrier, stepSums[step++ & 1], 2, sums, [&](size_t begin, size_t end, double* blockSum) {
+                Multiply(p.data(), q.data(), begin, end);
+                double pq0 = 0.0, pq1 = 0.0;
+                for(size_t i = begin; i < end; i++) {
+                    pq0 += p[2 * i + 0] * q[2 * i + 0];
+                    pq1 += p[2 * i + 1] * q[2 * i + 1];
+                }
+                blockSum[0] = pq0;
+                blockSum[1] = pq1;
+            });
+            for(int c = 0; c < 2; c++) {
+                alpha[c] = active[c] ? absNew[c] / sums[c] : 0.0;
+            }
+
+            // x += alpha * p, r -= alpha * q, z = M^-1 * r
+            ForBlocks(M, blockBegin, blockEnd, barrier, stepSums[step++ & 1], 4, sums, [&](size_t begin, size_t end, double* blockSum) {
+                double rr[2] = { 0.0, 0.0 };
+                double rz[2] = { 0.0, 0.0 };
+                for(int c = 0; c < 2; c++) {
+                    if(!active[c]) {
+                        continue;
+                    }
+                    for(size_t i = begin; i < end; i++) {
+                        const double inverse = diagonal[i] != 0.0 ? 1.0 / diagonal[i] : 1.0;
+                        x[2 * i + c] += alpha[c] * p[2 * i + c];
+                        r[2 * i + c] -= alpha[c] * q[2 * i + c];
+                        z[2 * i + c] = inverse * r[2 * i + c];
+                        rr[c] += r[2 * i + c] * r[2 * i + c];
+                        rz[c] += r[2 * i + c] * z[2 * i + c];
+                    }
+                }
+                blockSum[0] = rr[0];
+                blockSum[1] = rr[1];
+                blockSum[2] = rz[0];
+                blockSum[3] = rz[1];
+            });
+            for(int c = 0; c < 2; c++) {
+                if(!active[c]) {
+                    continue;
+                }
+                residualNorm2[c] = sums[c];
+                if(residualNorm2[c] < threshold[c]) {
+                    active[c] = false;
+                    columnIterations[c] = iteration;
+                    continue;
+                }
+                beta[c] = sums[2 + c] / absNew[c];
+                absNew[c] = sums[2 + c];
+            }
+
+            // the others only read stop after the barrier at the end of this step, and have
+            // all done so before the first thread gets here again.
+            if(chunk == 0) {
+                stop = std::chrono::steady_clock::now() >= deadline || cancelled();
+            }
+
+            // p = z + beta * p
+            ForBlocks(M, blockBegin, blockEnd, barrier, stepSums[step++ & 1], 0, sums, [&](size_t begin, size_t end, double*) {
+                for(int c = 0; c < 2; c++) {
+                    if(!active[c]) {
+                        continue;
+                    }
+                    for(size_t i = begin; i < end; i++) {
+                        p[2 * i + c] = z[2 * i + c] + beta[c] * p[2 * i + c];
+                    }
+                }
+            });
+            iteration++;
+        }
+
+        // every thread has the same results.
+        if(chunk != 0) {
+            return;
+        }
+        iterations = 0;
+        residual = 0.0;
+        for(int c = 0; c < 2; c++) {
+            if(active[c]) {
+                columnIterations[c] = iteration;
+            }
+            iterations = std::max(iterations, columnIterations[c]);
+            if(rhsNorm2[c] > 0.0) {
+                residual = std::max(residual, sqrt(residualNorm2[c] / rhsNorm2[c]));
+            }
+        }
+        converged = !active[0] && !active[1];
+    });
+
+    for(int i = 0; i < M; i++) {
+        X[i] = x[2 * i + 0];
+        X[M + i] = x[2 * i + 1];
+    }
+    return converged;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include "indexed_half_edge_mesh.hpp"
+
+//
+// Jacobi preconditioned Conjugate Gradient on the linear system of the uv mapper, without
+// ever building W. Every product with W is computed from the harmonic weights of the edges,
+// one float per edge, straight from the edges of every vertex of the half edge mesh:
+//
+//   (W * p)[i] = W_ii * p[i] - sum_{unknown j} w_ij * p[j]
+//
+// So besides the weights, it only needs the diagonal of W, and one index per edge to find
+// the unknown at the other end of the edge. That is a fraction of the memory of W, which
+// takes a double and an index for both directions of every edge, and more for the pattern.
+//
+// Both uv coordinates are iterated together, so that every pass over the edges computes
+// the products of both, and every column is iterated until it converges by itself. The
+// products are split over the unknowns, and the dot products are added up in blocks of
+// a fixed size, so the result is the same for any number of threads. The threads are
+// started once per Solve, and wait for each other between the steps of the iterations.
+//
+class MatrixFreeConjugateGradient {
+public:
+    MatrixFreeConjugateGradient();
+
+    // Finds the unknowns of the edges of the mesh. Only depends on the connectivity.
+    // unknownIndex is the index of every vertex among the M unknowns, or INVALID_INDEX
+    // if it is fixed. The mesh must be kept until the last Solve.
+    void Setup(const IndexedHalfEdgeMesh& hem, const uint32_t* unknownIndex, int M, int numThreads);
+
+    // W is the harmonic weight of every edge, which must be kept until the last Solve,
+    // and the diagonal, which the caller fills in, like the right hand sides.
+    void SetWeights(const float* weights) { this->weights = weights; }
+    double* Diagonal() { return diagonal.data(); }
+
+    // Solves W * X = B, where B and X are column-major M x 2 matrices, starting from X, until
+    // the residual |W*x - b| / |b| of both columns is below tolerance, or for at most
+    // maxIterations iterations, or until the deadline, or until cancelled returns true, which
+    // it is asked once every iteration, on a single thread. iterations and residual receive
+    // the largest of the two columns. Returns whether both columns converged.
+    bool Solve(
+        const double* B, double* X, double tolerance, int maxIterations,
+        std::chrono::steady_clock::time_point deadline, const std::function<bool()>& cancelled,
+        int& iterations, double& residual);
+
+    // the number of times one of its buffers has had to grow.
+    size_t NumAllocations() const { return numAllocations; }
+
+private:
+    // Q = W * P, for the unknowns [begin, end).
+    void Multiply(const double* P, double* Q, size_t begin, size_t end) const;
+
+    const IndexedHalfEdgeMesh* hem;
+    int M;
+    int numThreads;
+
+    std::vector<uint32_t> unknownVertices; // the vertex of every unknown.
+
+    // the unknowns of the two vertices of every edge, xor-ed together, where a fixed vertex
+    // counts as the unknown M. Xor-ing with one of the unknowns gives the other.
+    std::vector<uint32_t> edgeUnknowns;
+
+    const float* weights;
+    std::vector<double> diagonal;
+
+    // the vectors of the iterations, with the two columns interleaved. P has an extra
+    // row of zeros for the fixed vertices, at M.
+    std::vector<double> x;
+    std::vector<double> r;
+    std::vector<double> z;
+    std::vector<double> p;
+    std::vector<double> q;
+    std::vector<double> blockSums;
+
+    size_t numAllocations;
+};
@@ -0,0 +1,290 @@
+#include "mesh_simplification.hpp"
+#include "buffer.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+using std::vector;
+
+MeshSimplifier::MeshSimplifier() : hem(NULL), stamp(0), numAllocations(0) {
+}
+
+// Calls fn(corner) for every corner of a face around v that is still there, and drops the
+// corners of the removed faces from the list on the way.
+template<typename Function>
+void MeshSimplifier::ForEachCorner(uint32_t v, Function fn) {
+    uint32_t previous = INVALID_INDEX;
+    uint32_t corner = cornerHead[v];
+    while(corner != INVALID_INDEX) {
+        const uint32_t next = cornerNext[corner];
+        if(!faceAlive[corner / 3]) {
+            if(previous == INVALID_INDEX) {
+                cornerHead[v] = next;
+            } else {
+                cornerNext[previous] = next;
+            }
+            if(cornerTail[v] == corner) {
+                cornerTail[v] = previous;
+            }
+        } else {
+            fn(corner);
+            previous = corner;
+        }
+        corner = next;
+    }
+}
+
+// the faces that a collapse makes must be at least this good, see FaceQuality.
+static const float MIN_QUALITY = 0.3f;
+
+// 1 for an equilateral face, and 0 for a degenerate one. normal is the cross product of two edges.
+static float FaceQuality(const vec3& normal, const vec3& p0, const vec3& p1, const vec3& p2) {
+    const float lengths = vec3::dot(p1 - p0, p1 - p0) + vec3::dot(p2 - p1, p2 - p1) + vec3::dot(p0 - p2, p0 - p2);
+    return lengths > 0.0f ? 2.0f * sqrtf(3.0f) * vec3::length(normal) / lengths : 0.0f;
+}
+
+// the other two vertices of the face of the corner.
+#define NEXT_VERTEX(corner) faceVertices[3 * ((corner) / 3) + ((corner) + 1) % 3]
+#define PREVIOUS_VERTEX(corner) faceVertices[3 * ((corner) / 3) + ((corner) + 2) % 3]
+
+// Whether a can be moved onto its neighbour b. The neighbours of a must be marked with stamp.
+bool MeshSimplifier::CanCollapse(uint32_t a, uint32_t b) {
+    // the two faces of the edge, and the vertices across them.
+    int numShared = 0;
+    uint32_t across[2] = { INVALID_INDEX, INVALID_INDEX };
+    bool flips = false;
+    const vec3 pb = hem->Position(b);
+    ForEachCorner(a, [&](uint32_t corner) {
+        const uint32_t x = NEXT_VERTEX(corner);
+        const uint32_t y = PREVIOUS_VERTEX(corner);
+        if(x == b || y == b) {
+            if(numShared < 2) {
+                across[numShared] = x == b ? y : x;
+            }
+            numShared++;
+            return;
+        }
+
+        // the face must not flip when a moves to b, nor become a sliver, unless it already is one.
+        const vec3 pa = hem->Position(a);
+        const vec3 px = hem->Position(x);
+        const vec3 py = hem->Position(y);
+        const vec3 before = vec3::cross(px - pa, py - pa);
+        const vec3 after = vec3::cross(px - pb, py - pb);
+        if(vec3::dot(before, after) <= 0.0f) {
+            flips = true;
+        }
+        const float quality = FaceQuality(after, pb, px, py);
+        if(quality < MIN_QUALITY && quality < FaceQuality(before, pa, px, py)) {
+            flips = true;
+        }
+    });
+    if(numShared != 2 || across[0] == across[1] || flips) {
+        return false;
+    }
+
+    // the link condition: a and b share no neighbours besides the two across the edge.
+    bool shared = false;
+    ForEachCorner(b, [&](uint32_t corner) {
+        const uint32_t x = NEXT_VERTEX(corner);
+        const uint32_t y = PREVIOUS_VERTEX(corner);
+        if((vertexMark[x] == stamp && x != across[0] && x != across[1]) ||
+           (vertexMark[y] == stamp && y != across[0] && y != across[1])) {
+            shared = true;
+        }
+    });
+    if(shared) {
+        return false;
+    }
+
+    // and the vertices across the edge must keep enough faces, since they lose one each. A
+    // vertex on a boundary with a single face would only have boundary edges, which have no
+    // weight, so it would have nothing to tie its uvs down on a hole.
+    for(int k = 0; k < 2; k++) {
+        int numFaces = 0;
+        ForEachCorner(across[k], [&](uint32_t) { numFaces++; });
+        if(numFaces <= (vertexBoundary[across[k]] ? 2 : 3)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Moves a onto the neighbour at its shortest edge that it can be moved onto, if any.
+bool MeshSimplifier::TryCollapse(uint32_t a, uint32_t pass) {
+    if(!vertexAlive[a] || vertexBoundary[a] || vertexPass[a] == pass) {
+        return false;
+    }
+
+    // the neighbours of a, from the shortest edge to the longest.
+    stamp++;
+    ring.clear();
+    ForEachCorner(a, [&](uint32_t corner) {
+        const uint32_t x = NEXT_VERTEX(corner);
+        const uint32_t y = PREVIOUS_VERTEX(corner);
+        if(vertexMark[x] != stamp) {
+            vertexMark[x] = stamp;
+            PushBuffer(ring, x, numAllocations);
+        }
+        if(vertexMark[y] != stamp) {
+            vertexMark[y] = stamp;
+            PushBuffer(ring, y, numAllocations);
+        }
+    });
+    const vec3 pa = hem->Position(a);
+    std::sort(ring.begin(), ring.end(), [&](uint32_t x, uint32_t y) {
+        const float dx = vec3::dot(hem->Position(x) - pa, hem->Position(x) - pa);
+        const float dy = vec3::dot(hem->Position(y) - pa, hem->Position(y) - pa);
+        return dx != dy ? dx < dy : x < y;
+    });
+
+    for(size_t i = 0; i < ring.size(); i++) {
+        const uint32_t b = ring[i];
+        if(b == a || !CanCollapse(a, b)) {
+            continue;
+        }
+
+        PushBuffer(collapseVertices, a, numAllocations);
+        PushBuffer(collapseRingBegin, (uint32_t)collapseRings.size(), numAllocations);
+        for(size_t j = 0; j < ring.size(); j++) {
+            PushBuffer(collapseRings, ring[j], numAllocations);
+            vertexPass[ring[j]] = pass;
+        }
+
+        // the faces of the edge are removed, and the rest of the faces of a now use b.
+        ForEachCorner(a, [&](uint32_t corner) {
+            if(NEXT_VERTEX(corner) == b || PREVIOUS_VERTEX(corner) == b) {
+                faceAlive[corner / 3] = 0;
+            } else {
+                faceVertices[corner] = b;
+            }
+        });
+        if(cornerHead[a] != INVALID_INDEX) {
+            if(cornerHead[b] == INVALID_INDEX) {
+                cornerHead[b] = cornerHead[a];
+            } else {
+                cornerNext[cornerTail[b]] = cornerHead[a];
+            }
+            cornerTail[b] = cornerTail[a];
+        }
+        cornerHead[a] = INVALID_INDEX;
+        cornerTail[a] = INVALID_INDEX;
+        vertexAlive[a] = 0;
+        return true;
+    }
+    return false;
+}
+
+#undef NEXT_VERTEX
+#undef PREVIOUS_VERTEX
+
+void MeshSimplifier::Simplify(const IndexedHalfEdgeMesh& hem, size_t targetVertices) {
+    this->hem = &hem;
+    const size_t numVertices = hem.NumVertices();
+    const size_t numCorners = 3 * hem.NumFaces();
+
+    ResizeBuffer(faceVertices, numCorners, numAllocations);
+    std::copy(hem.FaceVertices(), hem.FaceVertices() + numCorners, faceVertices.begin());
+    AssignBuffer(faceAlive, hem.NumFaces(), (char)1, numAllocations);
+
+    AssignBuffer(vertexAlive, numVertices, (char)1, numAllocations);
+    AssignBuffer(vertexBoundary, numVertices, (char)0, numAllocations);
+    AssignBuffer(vertexPass, numVertices, 0u, numAllocations);
+    AssignBuffer(vertexMark, numVertices, 0u, numAllocations);
+    stamp = 0;
+    for(EdgeIndex e = 0; e < hem.NumEdges(); e++) {
+        if(hem.IsBoundaryEdge(e)) {
+            const HalfEdgeIndex he = hem.EdgeHalfEdge(e);
+            vertexBoundary[hem.Vertex(he)] = 1;
+            vertexBoundary[hem.Vertex(hem.Next(he))] = 1;
+        }
+    }
+
+    AssignBuffer(cornerHead, numVertices, INVALID_INDEX, numAllocations);
+    AssignBuffer(cornerTail, numVertices, INVALID_INDEX, numAllocations);
+    ResizeBuffer(cornerNext, numCorners, numAllocations);
+    for(size_t c = numCorners; c-- > 0;) {
+        const uint32_t v = faceVertices[c];
+        cornerNext[c] = cornerHead[v];
+        if(cornerHead[v] == INVALID_INDEX) {
+            cornerTail[v] = c;
+        }
+        cornerHead[v] = c;
+
+        // the vertices of degenerate faces are left where they are.
+        const uint32_t* face = &faceVertices[3 * (c / 3)];
+        if(face[0] == face[1] || face[1] == face[2] || face[2] == face[0]) {
+            vertexBoundary[v] = 1;
+        }
+    }
+
+    collapseVertices.clear();
+    collapseRingBegin.clear();
+    collapseRings.clear();
+    // every pass only goes over the vertices that could still be moved.
+    candidates.clear();
+    for(uint32_t v = 0; v < numVertices; v++) {
+        if(!vertexBoundary[v]) {
+            PushBuffer(candidates, v, numAllocations);
+        }
+    }
+    size_t numAlive = numVertices;
+    for(uint32_t pass = 1; numAlive > targetVertices; pass++) {
+        const size_t numBefore = numAlive;
+        for(size_t i = 0; i < candidates.size() && numAlive > targetVertices; i++) {
+            if(TryCollapse(candidates[i], pass)) {
+                numAlive--;
+            }
+        }
+        if(numAlive == numBefore) {
+            break;
+        }
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+            [&](uint32_t v) { return !vertexAlive[v]; }), candidates.end());
+    }
+    PushBuffer(collapseRingBegin, (uint32_t)collapseRings.size(), numAllocations);
+
+    // the simplified mesh, with the vertices that are left numbered in order.
+    coarseVertices.clear();
+    coarsePositions.clear();
+    for(uint32_t v = 0; v < numVertices; v++) {
+        if(vertexAlive[v]) {
+            vertexMark[v] = coarseVertices.size();
+            PushBuffer(coarseVertices, v, numAllocations);
+            const vec3 p = hem.Position(v);
+            PushBuffer(coarsePositions, p.x, numAllocations);
+            PushBuffer(coarsePositions, p.y, numAllocations);
+            PushBuffer(coarsePositions, p.z, numAllocations);
+        }
+    }
+    coarseIndices.clear();
+    for(size_t f = 0; f < hem.NumFaces(); f++) {
+        if(faceAlive[f]) {
+            for(int k = 0; k < 3; k++) {
+                PushBuffer(coarseIndices, (int)vertexMark[faceVertices[3 * f + k]], numAllocations);
+            }
+        }
+    }
+}
+
+void MeshSimplifier::Prolong(const float* coarseUvs, float* uvs) const {
+    for(size_t i = 0; i < coarseVertices.size(); i++) {
+        uvs[2 * coarseVertices[i] + 0] = coarseUvs[2 * i + 0];
+        uvs[2 * coarseVertices[i] + 1] = coarseUvs[2 * i + 1];
+    }
+
+    // the neighbours of every moved vertex were all still there when it was moved, so
+    // they all have their uvs when the collapses are undone in reverse.
+    for(size_t k = collapseVertices.size(); k-- > 0;) {
+        const uint32_t begin = collapseRingBegin[k];
+        const uint32_t end = collapseRingBegin[k + 1];
+        float u = 0.0f;
+        float v = 0.0f;
+        for(uint32_t i = begin; i < end; i++) {
+            u += uvs[2 * collapseRings[i] + 0];
+            v += uvs[2 * collapseRings[i] + 1];
+        }
+        uvs[2 * collapseVertices[k] + 0] = u / (end - begin);
+        uvs[2 * collapseVertices[k] + 1] = v / (end - begin);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "indexed_half_edge_mesh.hpp"
+
+//
+// Simplifies a half edge mesh by collapsing edges, for a quick uv map of a coarse version
+// of the mesh, which is then interpolated back to all the vertices of the mesh.
+//
+// Every collapse moves a vertex onto one of its neighbours, the one at the shortest edge, and
+// removes the two faces of the edge. The vertices on a boundary are never moved, so the
+// simplified mesh has exactly the same boundary loops, with the same lengths, and so exactly
+// the same fixed uvs as the mesh. A collapse is only made if it keeps the mesh manifold (the
+// link condition: the vertices of the edge only share the two neighbours across its faces),
+// and if it neither flips a face nor turns one into a sliver, which would get large negative
+// harmonic weights. The collapses are made in passes over the vertices, and a pass does not
+// move the neighbours of a vertex that it has already moved, so that the collapses are spread
+// evenly over the mesh.
+//
+// The half edge mesh can not change, so the collapses are made on lists of the corners of
+// the faces around every vertex. A collapse appends the list of the vertex to the list of the
+// neighbour it moves onto, and the corners of the removed faces are dropped from the lists as
+// the lists are walked.
+//
+class MeshSimplifier {
+public:
+    MeshSimplifier();
+
+    // Collapses edges until at most targetVertices vertices are left, or until no more edges
+    // can be collapsed.
+    void Simplify(const IndexedHalfEdgeMesh& hem, size_t targetVertices);
+
+    // the simplified mesh, which uses a subset of the vertices of the mesh.
+    size_t NumVertices() const { return coarseVertices.size(); }
+    size_t NumFaces() const { return coarseIndices.size() / 3; }
+    const float* Positions() const { return coarsePositions.data(); }
+    const int* Indices() const { return coarseIndices.data(); }
+    uint32_t Vertex(size_t i) const { return coarseVertices[i]; } // the vertex of the mesh of simplified vertex i.
+
+    // Interpolates the uvs of the simplified mesh to all the vertices of the mesh. Every moved
+    // vertex gets the average of the uvs of its neighbours at the time it was moved, with the
+    // collapses undone in reverse. coarseUvs has two floats for every vertex of the simplified
+    // mesh, and uvs receives two for every vertex of the mesh.
+    void Prolong(const float* coarseUvs, float* uvs) const;
+
+    // the number of times one of its buffers has had to grow.
+    size_t NumAllocations() const { return numAllocations; }
+
+private:
+    template<typename Function>
+    void ForEachCorner(uint32_t v, Function fn);
+
+    bool TryCollapse(uint32_t a, uint32_t pass);
+    bool CanCollapse(uint32_t a, uint32_t b);
+
+    const IndexedHalfEdgeMesh* hem;
+
+    // the vertices of every face, which collapses change, and whether it is still there.
+    std::vector<uint32_t> faceVertices;
+    std::vector<char> faceAlive;
+
+    // the corners of the faces around every vertex, as linked lists.
+    std::vector<uint32_t> cornerHead;
+    std::vector<uint32_t> cornerTail;
+    std::vector<uint32_t> cornerNext;
+
+    std::vector<char> vertexAlive;
+    std::vector<char> vertexBoundary;
+    std::vector<uint32_t> vertexPass; // the last pass that moved the vertex or one of its neighbours.
+    std::vector<uint32_t> vertexMark; // scratch marks, with a new stamp for every use.
+    uint32_t stamp;
+    std::vector<uint32_t> ring;
+    std::vector<uint32_t> candidates; // the vertices that are left, besides those that are never moved.
+
+    // every collapse, in order: the moved vertex, and where its neighbours start in collapseRings.
+    std::vector<uint32_t> collapseVertices;
+    std::vector<uint32_t> collapseRingBegin;
+    std::vector<uint32_t> collapseRings;
+
+    std::vector<uint32_t> coarseVertices;
+    std::vector<float> coarsePositions;
+    std::vector<int> coarseIndices;
+
+    size_t numAllocations;
+};
@@ -0,0 +1,310 @@
+#include "multigrid.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+using std::vector;
+
+// unknowns i and j are strongly connected if |a_ij| >= STRENGTH * sqrt(a_ii * a_jj).
+static const double STRENGTH = 0.08;
+
+// once a level has no more unknowns than this, it is solved directly.
+static const int MAX_COARSE_SIZE = 1000;
+
+static const int MAX_LEVELS = 25;
+
+AlgebraicMultigrid::AlgebraicMultigrid() : status(Eigen::InvalidInput) {
+}
+
+//
+// Groups the unknowns into aggregates of strongly connected unknowns. aggregates[i]
+// receives the aggregate of unknown i. This is the standard greedy aggregation:
+//
+// 1. every unknown that has no aggregated strong neighbour starts a new aggregate
+//    with all of its strong neighbours.
+// 2. the unknowns left over join the aggregate of one of their strong neighbours.
+// 3. whatever is still left (unknowns with no strong neighbours at all) forms
+//    aggregates of its own.
+//
+// The unknowns are visited in order, so the result is deterministic.
+//
+template<typename Matrix>
+static void Aggregate(
+    const Matrix& A, const Eigen::VectorXd& invDiag, vector<int>& aggregates, int& numAggregates) {
+    const int n = A.rows();
+    const int* Ap = A.outerIndexPtr();
+    const int* Ai = A.innerIndexPtr();
+    const double* Ax = A.valuePtr();
+
+    // A is symmetric, so column i is also row i.
+    #define IS_STRONG(i, p) (Ai[p] != (i) && Ax[p] * Ax[p] * invDiag[i] * invDiag[Ai[p]] >= STRENGTH * STRENGTH)
+
+    aggregates.assign(n, -1);
+    numAggregates = 0;
+
+    // 1.
+    for(int i = 0; i < n; i++) {
+        if(aggregates[i] != -1) {
+            continue;
+        }
+        bool isFree = true;
+        bool hasStrong = false;
+        for(int p = Ap[i]; p < Ap[i + 1]; p++) {
+            if(IS_STRONG(i, p)) {
+                hasStrong = true;
+                if(aggregates[Ai[p]] != -1) {
+                    isFree = false;
+                    break;
+                }
+            }
+        }
+        if(!isFree || !hasStrong) {
+            continue;
+        }
+        aggregates[i] = numAggregates;
+        for(int p = Ap[i]; p < Ap[i + 1]; p++) {
+            if(IS_STRONG(i, p)) {
+                aggregates[Ai[p]] = numAggregates;
+            }
+        }
+        numAggregates++;
+    }
+
+    // 2. only the aggregates from step 1 are joined, so that aggregates do not
+    // grow long chains.
+    vector<int> firstAggregates(aggregates);
+    for(int i = 0; i < n; i++) {
+        if(aggregates[i] != -1) {
+            continue;
+        }
+        for(int p = Ap[i]; p < Ap[i + 1]; p++) {
+            if(IS_STRONG(i, p) && firstAggregates[Ai[p]] != -1) {
+                aggregates[i] = firstAggregates[Ai[p]];
+                break;
+            }
+        }
+    }
+
+    // 3.
+    for(int i = 0; i < n; i++) {
+        if(aggregates[i] != -1) {
+            continue;
+        }
+        aggregates[i] = numAggregates;
+        for(int p = Ap[i]; p < Ap[i + 1]; p++) {
+            if(IS_STRONG(i, p) && aggregates[Ai[p]] == -1) {
+                aggregates[Ai[p]] = numAggregates;
+            }
+        }
+        numAggregates++;
+    }
+
+    #undef IS_STRONG
+}
+
+template<typename Matrix>
+static void InverseDiagonal(const Matrix& A, Eigen::VectorXd& invDiag) {
+    invDiag.resize(A.rows());
+    for(int j = 0; j < A.outerSize(); j++) {
+        double d = 0.0;
+        for(typename Matrix::InnerIterator it(A, j); it; ++it) {
+            if(it.index() == j) {
+                d = it.value();
+            }
+        }
+        invDiag[j] = d != 0.0 ? 1.0 / d : 1.0;
+    }
+}
+
+void AlgebraicMultigrid::Setup(const SparseMatrix& A) {
+    if(A.isCompressed()) {
+        fineCopy = SparseMatrix();
+        Setup(A.outerIndexPtr(), A.innerIndexPtr(), A.valuePtr(), A.rows(), A.nonZeros());
+    } else {
+        fineCopy = A;
+        fineCopy.makeCompressed();
+        Setup(fineCopy.outerIndexPtr(), fineCopy.innerIndexPtr(), fineCopy.valuePtr(), fineCopy.rows(), fineCopy.nonZeros());
+    }
+}
+
+void AlgebraicMultigrid::Setup(const Eigen::Ref<const SparseMatrix>& A) {
+    // a Ref is always compressed.
+    fineCopy = SparseMatrix();
+    Setup(A.outerIndexPtr(), A.innerIndexPtr(), A.valuePtr(), A.rows(), A.nonZeros());
+}
+
+void AlgebraicMultigrid::Setup(const int* outer, const int* inner, const double* values, int n, int nonZeros) {
+    fine.reset(new SparseMatrixMap(n, n, nonZeros, outer, inner, values));
+
+    levels.clear();
+    levels.push_back(Level());
+
+    while(levels.size() < MAX_LEVELS && LevelSize(levels.size() - 1) > MAX_COARSE_SIZE) {
+        Level& fineLevel = levels.back();
+        Level coarse;
+        if(!(levels.size() == 1 ? Coarsen(*fine, fineLevel, coarse) : Coarsen(fineLevel.A, fineLevel, coarse))) {
+            break;
+        }
+        levels.push_back(coarse);
+    }
+
+    // without a coarser level, the input matrix itself is solved directly.
+    const int coarsestSize = LevelSize(levels.size() - 1);
+    Level& coarsest = levels.back();
+    coarsest.b.resize(coarsestSize);
+    coarsest.x.resize(coarsestSize);
+    if(levels.size() == 1) {
+        coarseSolver.compute(*fine);
+    } else {
+        coarseSolver.compute(coarsest.A);
+    }
+    status = coarseSolver.info();
+}
+
+// Builds the coarser level of the level with the matrix Af. Returns false if the coarsening
+// has stalled, so that more levels would not help.
+template<typename Matrix>
+bool AlgebraicMultigrid::Coarsen(const Matrix& Af, Level& fineLevel, Level& coarseLevel) {
+    const int n = Af.rows();
+    InverseDiagonal(Af, fineLevel.invDiag);
+
+    vector<int> aggregates;
+    int numAggregates;
+    Aggregate(Af, fineLevel.invDiag, aggregates, numAggregates);
+
+    if(numAggregates > n * 9 / 10) {
+        return false;
+    }
+
+    // the tentative prolongator interpolates every aggregate by a constant,
+    // which is exactly the null space of the Laplacian away from the boundary.
+    SparseMatrix T(n, numAggregates);
+    vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(n);
+    for(int i = 0; i < n; i++) {
+        triplets.push_back(Eigen::Triplet<double>(i, aggregates[i], 1.0));
+    }
+    T.setFromTriplets(triplets.begin(), triplets.end());
+
+    // smooth it with a damped Jacobi step, P = (I - omega * D^-1 * A) * T,
+    // where omega = 4/3 / rho(D^-1 * A). rho is bounded with Gershgorin's theorem.
+    double rho = 0.0;
+    for(int j = 0; j < Af.outerSize(); j++) {
+        double sum = 0.0;
+        for(typename Matrix::InnerIterator it(Af, j); it; ++it) {
+            sum += fabs(it.value());
+        }
+        rho = std::max(rho, sum * fabs(fineLevel.invDiag[j]));
+    }
+    const double omega = (4.0 / 3.0) / rho;
+
+    SparseMatrix AT = Af * T;
+    for(int j = 0; j < AT.outerSize(); j++) {
+        for(SparseMatrix::InnerIterator it(AT, j); it; ++it) {
+            it.valueRef() *= omega * fineLevel.invDiag[it.index()];
+        }
+    }
+    fineLevel.P = T - AT;
+    fineLevel.R = fineLevel.P.transpose();
+
+    // the Galerkin coarse matrix, R * A * P.
+    coarseLevel.A = fineLevel.R * SparseMatrix(Af * fineLevel.P);
+    coarseLevel.A.makeCompressed();
+
+    fineLevel.b.resize(n);
+    fineLevel.x.resize(n);
+    fineLevel.r.resize(n);
+    return true;
+}
+
+// one sweep of Gauss-Seidel over x, forward or backward. A is symmetric,
+// so column i of A is also row i.
+template<typename Matrix>
+static void GaussSeidel(const Matrix& A, const Eigen::VectorXd& invDiag, const Eigen::VectorXd& b, Eigen::VectorXd& x, bool forward) {
+    const int n = A.rows();
+    const int* Ap = A.outerIndexPtr();
+    const int* Ai = A.innerIndexPtr();
+    const double* Ax = A.valuePtr();
+
+    for(int k = 0; k < n; k++) {
+        const int i = forward ? k : n - 1 - k;
+        double sum = b[i];
+        for(int p = Ap[i]; p < Ap[i + 1]; p++) {
+            if(Ai[p] != i) {
+                sum -= Ax[p] * x[Ai[p]];
+            }
+        }
+        x[i] = sum * invDiag[i];
+    }
+}
+
+// runs a V-cycle from the level down, solving for levels[level].b starting from zero.
+// A is the matrix of the level.
+template<typename Matrix>
+void AlgebraicMultigrid::Cycle(const Matrix& A, int level) const {
+    Level& l = levels[level];
+
+    if(level + 1 == (int)levels.size()) {
+        l.x = coarseSolver.solve(l.b);
+        return;
+    }
+
+    l.x.setZero();
+    GaussSeidel(A, l.invDiag, l.b, l.x, true);
+
+    // correct the remaining error on the coarser level.
+    l.r = l.b - A * l.x;
+    Level& c = levels[level + 1];
+    c.b = l.R * l.r;
+    Cycle(c.A, level + 1);
+    l.x += l.P * c.x;
+
+    GaussSeidel(A, l.invDiag, l.b, l.x, false);
+}
+
+void AlgebraicMultigrid::VCycle(const double* b, double* x) {
+    const int n = rows();
+    levels[0].b = Eigen::VectorXd::Map(b, n);
+    Cycle(*fine, 0);
+    Eigen::VectorXd::Map(x, n) = levels[0].x;
+}
+
+Eigen::VectorXd AlgebraicMultigrid::solve(const Eigen::VectorXd& b) const {
+    levels[0].b = b;
+    Cycle(*fine, 0);
+    return levels[0].x;
+}
+
+void AlgebraicMultigrid::Iterate(
+    const double* b,
+    double* x,
+    double tolerance,
+    int maxIterations,
+    const std::function<bool()>& cancelled,
+    int& iterations,
+    double& residual) {
+
+    const int n = rows();
+    const SparseMatrixMap& A = *fine;
+    Eigen::VectorXd::ConstMapType B(b, n);
+    Eigen::VectorXd::MapType X(x, n);
+
+    const double bNorm = B.norm();
+    if(bNorm == 0.0) {
+        X.setZero();
+        iterations = 0;
+        residual = 0.0;
+        return;
+    }
+
+    // every iteration corrects x by a V-cycle on the current residual.
+    Eigen::VectorXd r = B - A * X;
+    residual = r.norm() / bNorm;
+    iterations = 0;
+    while(residual > tolerance && iterations < maxIterations && !cancelled()) {
+        X += solve(r);
+        r = B - A * X;
+        residual = r.norm() / bNorm;
+        iterations++;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "linear_solvers.hpp"
+
+//
+// Smoothed aggregation algebraic multigrid, for symmetric positive definite
+// matrices like the Laplacian of the uv mapper.
+//
+// Compute builds a hierarchy of ever coarser matrices from the matrix alone, by
+// grouping strongly connected unknowns into aggregates. Every V-cycle then smooths
+// the error with Gauss-Seidel on every level, and solves the coarsest level directly.
+// Since every level removes the error that the finer levels are slow to remove,
+// the number of V-cycles needed hardly grows with the size of the matrix.
+//
+// It can be used alone, with Iterate, or as the preconditioner of Eigen's
+// ConjugateGradient. The V-cycle is symmetric (forward Gauss-Seidel before
+// the coarse correction, backward after), so that CG stays valid.
+//
+// The matrix must be symmetric, and stored in full.
+//
+// The matrix itself is the finest level, and is not copied, since it is by far the largest
+// matrix of the hierarchy. So it must be kept unchanged as long as the hierarchy is used.
+//
+class AlgebraicMultigrid {
+public:
+    AlgebraicMultigrid();
+
+    // Builds the hierarchy for the matrix A. A is only copied if it is not compressed.
+    void Setup(const SparseMatrix& A);
+    void Setup(const Eigen::Ref<const SparseMatrix>& A);
+
+    // Runs V-cycles until the residual |A*x - b| / |b| is below tolerance, or maxIterations
+    // V-cycles have been run, or cancelled returns true, which it is asked before every
+    // V-cycle. x is the initial guess, and receives the solution.
+    void Iterate(
+        const double* b,
+        double* x,
+        double tolerance,
+        int maxIterations,
+        const std::function<bool()>& cancelled,
+        int& iterations,
+        double& residual);
+
+    // Approximately solves A*x = b with a single V-cycle, starting from x = 0.
+    void VCycle(const double* b, double* x);
+
+    int NumLevels() const { return levels.size(); }
+    // the number of unknowns on the level. Level 0 is the input matrix.
+    int LevelSize(int level) const { return level == 0 ? rows() : levels[level].A.rows(); }
+
+    //
+    // The interface of an Eigen preconditioner.
+    //
+
+    template<typename MatType>
+    AlgebraicMultigrid& analyzePattern(const MatType&) { return *this; }
+
+    // Eigen's iterative solvers pass their matrix as a Ref, which refers to it without a copy.
+    template<typename MatType>
+    AlgebraicMultigrid& factorize(const MatType& mat) {
+        Setup(mat);
+        return *this;
+    }
+
+    template<typename MatType>
+    AlgebraicMultigrid& compute(const MatType& mat) { return factorize(mat); }
+
+    Eigen::VectorXd solve(const Eigen::VectorXd& b) const;
+
+    Eigen::ComputationInfo info() const { return status; }
+    Eigen::Index rows() const { return fine ? fine->rows() : 0; }
+    Eigen::Index cols() const { return rows(); }
+
+private:
+    typedef Eigen::Map<const SparseMatrix> SparseMatrixMap;
+
+    struct Level {
+        // empty on level 0, whose matrix is fine.
+        SparseMatrix A;
+        Eigen::VectorXd invDiag;
+
+        // P interpolates from the next coarser level to this level, and R = P^T
+        // restricts from this level to the coarser one. R is stored separately, since
+        // a transposed CSC product is far slower.
+        SparseMatrix P;
+        SparseMatrix R;
+
+        // scratch vectors of the V-cycle.
+        Eigen::VectorXd b;
+        Eigen::VectorXd x;
+        Eigen::VectorXd r;
+    };
+
+    void Setup(const int* outer, const int* inner, const double* values, int n, int nonZeros);
+    template<typename Matrix>
+    bool Coarsen(const Matrix& Af, Level& fineLevel, Level& coarseLevel);
+    template<typename Matrix>
+    void Cycle(const Matrix& A, int level) const;
+
+    // the V-cycle only changes scratch vectors, so solve can be const like Eigen expects.
+    mutable std::vector<Level> levels;
+
+    // the matrix of level 0, which refers to the matrix passed to Setup, or to fineCopy
+    // if that was not compressed.
+    std::unique_ptr<SparseMatrixMap> fine;
+    SparseMatrix fineCopy;
+
+    Eigen::SimplicialLDLT<SparseMatrix> coarseSolver;
+    Eigen::ComputationInfo status;
+};
@@ -0,0 +1,225 @@
+#include "nested_dissection.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+
+using std::vector;
+
+// parts with at most this many vertices are not split any further.
+static const int LEAF_SIZE = 64;
+
+// the owner of the vertices that have their final place in the order.
+static const int DONE = -1;
+
+enum Side {
+    SIDE_A,
+    SIDE_B,
+    SIDE_SEPARATOR,
+};
+
+//
+// Breadth first search from start, over the vertices v with owner[v] == part. level must be
+// -1 for all of them. queue receives the vertices in the order they are reached, and level
+// their distances from start. Returns the number of vertices reached.
+//
+static int Bfs(int start, int part, const int* outer, const int* inner, const int* owner, int* level, int* queue) {
+    int head = 0;
+    int tail = 0;
+    level[start] = 0;
+    queue[tail++] = start;
+    while(head < tail) {
+        const int v = queue[head++];
+        for(int p = outer[v]; p < outer[v + 1]; p++) {
+            const int w = inner[p];
+            if(owner[w] == part && level[w] == -1) {
+                level[w] = level[v] + 1;
+                queue[tail++] = w;
+            }
+        }
+    }
+    return tail;
+}
+
+//
+// Splits the part owned by begin, with the vertices nodes[0, size), into the sides A and B and
+// a separator between them, so that no vertex of A is a neighbour of a vertex of B. About
+// fraction of the vertices go to A. nodes is reordered as A, B and then the separator, and the
+// sides are then owned by begin and begin + numA, and the separator is DONE.
+//
+// Returns false, and leaves the part as it is, if the part is too narrow to split.
+//
+static bool Bisect(int begin, int size, double fraction, const int* outer, const int* inner,
+                   int* nodes, int* owner, int* level, int* queue, char* side, int& numA, int& numB) {
+    for(int i = 0; i < size; i++) {
+        level[nodes[i]] = -1;
+    }
+    int reached = Bfs(nodes[0], begin, outer, inner, owner, level, queue);
+
+    if(reached < size) {
+        // the part is not connected, so the reached component and the
+        // rest are already separated.
+        for(int i = 0; i < size; i++) {
+            side[nodes[i]] = level[nodes[i]] == -1 ? SIDE_B : SIDE_A;
+        }
+        numA = reached;
+        numB = size - reached;
+    } else {
+        // the last vertex reached is far from the others, and so the level sets
+        // of a search from it cut across the part.
+        const int far = queue[reached - 1];
+        for(int i = 0; i < size; i++) {
+            level[nodes[i]] = -1;
+        }
+        Bfs(far, begin, outer, inner, owner, level, queue);
+
+        const int maxLevel = level[queue[size - 1]];
+        if(maxLevel < 2) {
+            return false;
+        }
+
+        // the level of the vertex at the fraction separates the levels before it from those after it.
+        int separator = level[queue[(int)(size * fraction)]];
+        separator = std::max(1, std::min(separator, maxLevel - 1));
+
+        numA = 0;
+        numB = 0;
+        for(int i = 0; i < size; i++) {
+            const int v = nodes[i];
+            side[v] = level[v] < separator ? SIDE_A : (level[v] > separator ? SIDE_B : SIDE_SEPARATOR);
+        }
+        // separator vertices with no neighbour in B can just as well be in A.
+        for(int i = 0; i < size; i++) {
+            const int v = nodes[i];
+            if(side[v] != SIDE_SEPARATOR) {
+                continue;
+            }
+            bool touchesB = false;
+            for(int p = outer[v]; p < outer[v + 1] && !touchesB; p++) {
+                touchesB = owner[inner[p]] == begin && side[inner[p]] == SIDE_B;
+            }
+            if(!touchesB) {
+                side[v] = SIDE_A;
+            }
+        }
+        for(int i = 0; i < size; i++) {
+            numA += side[nodes[i]] == SIDE_A;
+            numB += side[nodes[i]] == SIDE_B;
+        }
+    }
+
+    // the part is reordered as A, B and then the separator, in the order of the search,
+    // which keeps neighbours close together.
+    if(reached < size) {
+        std::copy(nodes, nodes + size, queue);
+    }
+    int a = 0;
+    int b = numA;
+    int s = numA + numB;
+    for(int i = 0; i < size; i++) {
+        const int v = queue[i];
+        if(side[v] == SIDE_A) {
+            nodes[a++] = v;
+            owner[v] = begin;
+        } else if(side[v] == SIDE_B) {
+            nodes[b++] = v;
+            owner[v] = begin + numA;
+        } else {
+            nodes[s++] = v;
+            owner[v] = DONE;
+        }
+    }
+    return true;
+}
+
+void NestedDissection(int n, const int* outer, const int* inner, int* order) {
+    // every part is a range [begin, end) of order, and its vertices are owned by begin.
+    vector<int> owner(n, 0);
+    vector<int> level(n, -1);
+    vector<int> queue(n);
+    vector<char> side(n);
+    for(int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+
+    vector< std::pair<int, int> > parts;
+    if(n > 0) {
+        parts.push_back(std::make_pair(0, n));
+    }
+    while(!parts.empty()) {
+        const int begin = parts.back().first;
+        const int size = parts.back().second - begin;
+        parts.pop_back();
+        int* nodes = order + begin;
+
+        int numA;
+        int numB;
+        if(size <= LEAF_SIZE || !Bisect(begin, size, 0.5, outer, inner, nodes, owner.data(),
+                                         level.data(), queue.data(), side.data(), numA, numB)) {
+            for(int i = 0; i < size; i++) {
+                owner[nodes[i]] = DONE;
+            }
+            continue;
+        }
+
+        if(numA > 0) {
+            parts.push_back(std::make_pair(begin, begin + numA));
+        }
+        if(numB > 0) {
+            parts.push_back(std::make_pair(begin + numA, begin + numA + numB));
+        }
+    }
+}
+
+int PartitionGraph(int n, const int* outer, const int* inner, int numParts, int* part) {
+    // just like in NestedDissection, but every range also has the number of parts it is split into.
+    vector<int> order(n);
+    vector<int> owner(n, 0);
+    vector<int> level(n, -1);
+    vector<int> queue(n);
+    vector<char> side(n);
+    for(int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+
+    struct Range {
+        int begin;
+        int end;
+        int numParts;
+    };
+    vector<Range> ranges;
+    if(n > 0) {
+        Range all = { 0, n, std::max(numParts, 1) };
+        ranges.push_back(all);
+    }
+    int numFound = 0;
+    while(!ranges.empty()) {
+        const Range range = ranges.back();
+        const int size = range.end - range.begin;
+        ranges.pop_back();
+        int* nodes = order.data() + range.begin;
+
+        // the parts of the sides are about the same size, even for an odd number of parts.
+        const int partsA = range.numParts / 2;
+        int numA;
+        int numB;
+        if(range.numParts == 1 || !Bisect(range.begin, size, (double)partsA / range.numParts, outer, inner, nodes,
+                                          owner.data(), level.data(), queue.data(), side.data(), numA, numB)) {
+            for(int i = 0; i < size; i++) {
+                owner[nodes[i]] = DONE;
+                part[nodes[i]] = numFound;
+            }
+            numFound++;
+            continue;
+        }
+
+        for(int i = numA + numB; i < size; i++) {
+            part[nodes[i]] = -1;
+        }
+        Range a = { range.begin, range.begin + numA, partsA };
+        Range b = { range.begin + numA, range.begin + numA + numB, range.numParts - partsA };
+        ranges.push_back(a);
+        ranges.push_back(b);
+    }
+    return numFound;
+}
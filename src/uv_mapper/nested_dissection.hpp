@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Eigen/Sparse"
+
+//
+// Nested dissection ordering of the graph of a sparse matrix with a symmetric pattern.
+//
+// The graph of the uv mapper's matrix is the edge graph of the mesh, restricted to the
+// unknown vertices. So the graph is split in two by a ring of vertices around a breadth
+// first search, which on a triangle mesh is a short curve across the surface. Both halves
+// are ordered first, recursively, and the ring last, so that eliminating one half never
+// fills in anything in the other. Mesh graphs have small separators everywhere, so
+// the factor stays far sparser than with minimum degree orderings on large meshes.
+//
+// The pattern is given in compressed column form, with n columns. order[k] receives
+// the vertex that is eliminated k-th.
+//
+void NestedDissection(int n, const int* outer, const int* inner, int* order);
+
+// Splits the same graph into numParts parts of about the same size, by bisecting it recursively
+// just like NestedDissection does. part[v] receives the part of vertex v, or -1 for the vertices of
+// the separators, so that no two vertices in different parts are neighbours. Returns the number
+// of parts, which is less than numParts if the graph is too small or too narrow to split that often.
+int PartitionGraph(int n, const int* outer, const int* inner, int numParts, int* part);
+
+// The same, with the interface of an Eigen ordering method, so that it can be used
+// as the ordering of the sparse factorizations.
+// The matrix must be in compressed mode, just like for Eigen::COLAMDOrdering.
+class NestedDissectionOrdering {
+public:
+    typedef Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> PermutationType;
+
+    template<typename MatrixType>
+    void operator()(const MatrixType& mat, PermutationType& perm) {
+        eigen_assert(mat.isCompressed() && "NestedDissectionOrdering requires a sparse matrix in compressed mode");
+        perm.resize(mat.cols());
+        NestedDissection(mat.cols(), mat.outerIndexPtr(), mat.innerIndexPtr(), perm.indices().data());
+    }
+};
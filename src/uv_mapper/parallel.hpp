@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// Minimal helpers for running loops on several threads.
+//
+
+// the number of threads the machine can run at once. Always at least one.
+inline int NumHardwareThreads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+}
+
+// The number of chunks that ParallelFor splits [begin, end) into.
+// Chunks are never smaller than minChunkSize, because for small ranges
+// starting threads costs more than it saves.
+inline int NumChunks(size_t begin, size_t end, int numThreads, size_t minChunkSize) {
+    size_t n = end > begin ? end - begin : 0;
+    size_t maxChunks = (n + minChunkSize - 1) / minChunkSize;
+    if(numThreads < 1) {
+        numThreads = 1;
+    }
+    if(maxChunks < (size_t)numThreads) {
+        return maxChunks > 0 ? (int)maxChunks : 1;
+    }
+    return numThreads;
+}
+
+// The range of chunk i, when splitting [begin, end) into numChunks equally large chunks.
+inline void ChunkRange(size_t begin, size_t end, int numChunks, int i, size_t& chunkBegin, size_t& chunkEnd) {
+    size_t n = end - begin;
+    chunkBegin = begin + n * i / numChunks;
+    chunkEnd = begin + n * (i + 1) / numChunks;
+}
+
+//
+// Calls fn(chunkBegin, chunkEnd, chunkIndex) once for each of the
+// NumChunks(begin, end, numThreads, minChunkSize) consecutive chunks of
+// [begin, end), every chunk on its own thread. The chunks only depend on the
+// arguments, so as long as fn writes its results per chunk, the results are
+// deterministic. With a single chunk, fn is simply called on this thread.
+//
+template<typename Function>
+void ParallelFor(size_t begin, size_t end, int numThreads, size_t minChunkSize, Function fn) {
+    const int numChunks = NumChunks(begin, end, numThreads, minChunkSize);
+
+    if(numChunks == 1) {
+        fn(begin, end, 0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(numChunks - 1);
+    for(int i = 1; i < numChunks; i++) {
+        size_t chunkBegin, chunkEnd;
+        ChunkRange(begin, end, numChunks, i, chunkBegin, chunkEnd);
+        threads.push_back(std::thread(fn, chunkBegin, chunkEnd, i));
+    }
+
+    // the calling thread takes the first chunk.
+    size_t chunkBegin, chunkEnd;
+    ChunkRange(begin, end, numChunks, 0, chunkBegin, chunkEnd);
+    fn(chunkBegin, chunkEnd, 0);
+
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+//
+// Makes numThreads threads wait for each other. Wait returns once all of them have called
+// it, and the barrier can then be used again right away. Whatever a thread writes before
+// Wait is seen by all the threads after it.
+//
+class Barrier {
+public:
+    explicit Barrier(int numThreads) : numThreads(numThreads), numWaiting(0), generation(0) {}
+
+    void Wait() {
+        if(numThreads <= 1) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        const unsigned int current = generation;
+        if(++numWaiting == numThreads) {
+            numWaiting = 0;
+            generation++;
+            lock.unlock();
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [&]() { return generation != current; });
+    }
+
+private:
+    Barrier(const Barrier&);
+    Barrier& operator=(const Barrier&);
+
+    const int numThreads;
+    int numWaiting;
+    unsigned int generation;
+    std::mutex mutex;
+    std::condition_variable released;
+};
@@ -0,0 +1,619 @@
+#include "supernodal_cholesky.hpp"
+#include "nested_dissection.hpp"
+#include "Eigen/Cholesky"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using std::vector;
+
+// the dense updates are done in blocks of this many rows or columns, for any number of threads.
+static const int BLOCK_SIZE = 64;
+
+// fronts with at least this many rows below their columns split their dense updates over the idle threads.
+static const int PARALLEL_FRONT_SIZE = 256;
+
+// A child is merged into its parent supernode if the merged supernode has at most this many
+// columns and at most this fraction of zeros in its block. Any supernode gets few zeros.
+static const int RELAXED_WIDTHS[] = { 4, 16, 48 };
+static const double RELAXED_ZEROS[] = { 1.0, 0.5, 0.1 };
+static const double MAX_ZEROS = 0.05;
+
+struct SupernodalCholesky::Front {
+    vector<double> buffer;
+    vector<int> map; // the row in the front of every row of L.
+};
+
+// Dense blocks of a front, that any thread can run, in any order.
+struct BlockJob {
+    std::function<void(int)> run; // runs block k.
+    int numBlocks;
+    std::atomic<int> next; // the next block that no thread has taken yet.
+
+    // under the mutex of the workers.
+    int numFinished;
+    int numHelpers; // the threads other than the owner that are taking blocks.
+
+    BlockJob(const std::function<void(int)>& run, int numBlocks) :
+        run(run), numBlocks(numBlocks), next(0), numFinished(0), numHelpers(0) {}
+};
+
+// The threads of factorize, and the supernodes and blocks they share. A thread factors the ready
+// supernodes, and only while there are none, helps a large front with its blocks.
+struct SupernodalCholesky::Workers {
+    int numThreads;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    vector<int> pending; // the number of children of every supernode that are not done.
+    vector<int> ready;
+    vector<BlockJob*> jobs; // with blocks left to take.
+    int numDone;
+    bool failed;
+
+    // Takes and runs blocks of the job until there are none left. Returns how many it ran.
+    static int RunBlocks(BlockJob& job) {
+        int count = 0;
+        for(int k = job.next++; k < job.numBlocks; k = job.next++) {
+            job.run(k);
+            count++;
+        }
+        return count;
+    }
+
+    // Runs all the blocks, with the help of the idle threads, and returns once they are done.
+    void Split(int numBlocks, const std::function<void(int)>& run) {
+        BlockJob job(run, numBlocks);
+        if(numThreads > 1 && numBlocks > 1) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(&job);
+            }
+            changed.notify_all();
+        }
+
+        const int count = RunBlocks(job);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs.erase(std::remove(jobs.begin(), jobs.end(), &job), jobs.end());
+        job.numFinished += count;
+        changed.wait(lock, [&] { return job.numFinished == job.numBlocks && job.numHelpers == 0; });
+    }
+};
+
+SupernodalCholesky::SupernodalCholesky() : n(0), numThreads(1), status(Eigen::InvalidInput), factorNonZeros(0) {
+}
+
+//
+// The lower and upper triangle of A, in the order given by inverse[column of A] = position,
+// as compressed columns with sorted rows. lowerSlots receives where in A.valuePtr() every
+// element of the lower triangle is.
+//
+static void PermutedTriangles(const SparseMatrix& A, const vector<int>& inverse,
+                              vector<int>& lowerOuter, vector<int>& lowerInner, vector<int>& lowerSlots,
+                              vector<int>& upperOuter, vector<int>& upperInner) {
+    const int n = A.cols();
+    const int* outer = A.outerIndexPtr();
+    const int* inner = A.innerIndexPtr();
+    const int* nonZeros = A.innerNonZeroPtr();
+
+    lowerOuter.assign(n + 1, 0);
+    upperOuter.assign(n + 1, 0);
+    for(int j = 0; j < n; j++) {
+        const int end = nonZeros ? outer[j] + nonZeros[j] : outer[j + 1];
+        for(int p = outer[j]; p < end; p++) {
+            const int row = inverse[inner[p]];
+            const int col = inverse[j];
+            if(row >= col) {
+                lowerOuter[col + 1]++;
+            }
+            if(row < col) {
+                upperOuter[col + 1]++;
+            }
+        }
+    }
+    for(int j = 0; j < n; j++) {
+        lowerOuter[j + 1] += lowerOuter[j];
+        upperOuter[j + 1] += upperOuter[j];
+    }
+    lowerInner.resize(lowerOuter[n]);
+    lowerSlots.resize(lowerOuter[n]);
+    upperInner.resize(upperOuter[n]);
+
+    vector<int> lowerNext(lowerOuter.begin(), lowerOuter.end() - 1);
+    vector<int> upperNext(upperOuter.begin(), upperOuter.end() - 1);
+    for(int j = 0; j < n; j++) {
+        const int end = nonZeros ? outer[j] + nonZeros[j] : outer[j + 1];
+        for(int p = outer[j]; p < end; p++) {
+            const int row = inverse[inner[p]];
+            const int col = inverse[j];
+            if(row >= col) {
+                lowerInner[lowerNext[col]] = row;
+                lowerSlots[lowerNext[col]++] = p;
+            }
+            if(row < col) {
+                upperInner[upperNext[col]++] = row;
+            }
+        }
+    }
+
+    // the rows are sorted in A, but not after the permutation.
+    vector< std::pair<int, int> > column;
+    for(int j = 0; j < n; j++) {
+        column.clear();
+        for(int p = lowerOuter[j]; p < lowerOuter[j + 1]; p++) {
+            column.push_back(std::make_pair(lowerInner[p], lowerSlots[p]));
+        }
+        std::sort(column.begin(), column.end());
+        for(int p = lowerOuter[j]; p < lowerOuter[j + 1]; p++) {
+            lowerInner[p] = column[p - lowerOuter[j]].first;
+            lowerSlots[p] = column[p - lowerOuter[j]].second;
+        }
+        std::sort(upperInner.begin() + upperOuter[j], upperInner.begin() + upperOuter[j + 1]);
+    }
+}
+
+// The elimination tree, from the upper triangle. parent[j] is -1 at the roots.
+static void EliminationTree(int n, const vector<int>& upperOuter, const vector<int>& upperInner, vector<int>& parent) {
+    vector<int> ancestor(n, -1);
+    parent.assign(n, -1);
+    for(int k = 0; k < n; k++) {
+        for(int p = upperOuter[k]; p < upperOuter[k + 1]; p++) {
+            // follows the path from the row up to the root of its subtree, which becomes k,
+            // and short cuts the path on the way.
+            int i = upperInner[p];
+            while(i != -1 && i < k) {
+                const int next = ancestor[i];
+                ancestor[i] = k;
+                if(next == -1) {
+                    parent[i] = k;
+                }
+                i = next;
+            }
+        }
+    }
+}
+
+// post[k] receives the node that is k-th in a postorder of the tree, which visits the children in increasing order.
+static void Postorder(int n, const vector<int>& parent, vector<int>& post) {
+    vector<int> head(n, -1);
+    vector<int> next(n, -1);
+    vector<int> stack(n);
+    for(int j = n - 1; j >= 0; j--) {
+        if(parent[j] != -1) {
+            next[j] = head[parent[j]];
+            head[parent[j]] = j;
+        }
+    }
+    post.resize(n);
+    int k = 0;
+    for(int root = 0; root < n; root++) {
+        if(parent[root] != -1) {
+            continue;
+        }
+        int top = 0;
+        stack[0] = root;
+        while(top >= 0) {
+            const int j = stack[top];
+            const int child = head[j];
+            if(child == -1) {
+                top--;
+                post[k++] = j;
+            } else {
+                head[j] = next[child];
+                stack[++top] = child;
+            }
+        }
+    }
+}
+
+void SupernodalCholesky::analyzePattern(const SparseMatrix& A) {
+    n = A.cols();
+    status = Eigen::InvalidInput;
+    updates.clear();
+
+    // nested dissection, and then a postorder of the elimination tree, which keeps the
+    // fill of the ordering, but makes the columns of every subtree contiguous.
+    vector<int> order0(n);
+    {
+        SparseMatrix pattern = A;
+        pattern.makeCompressed();
+        NestedDissection(n, pattern.outerIndexPtr(), pattern.innerIndexPtr(), order0.data());
+    }
+    vector<int> inverse(n);
+    for(int k = 0; k < n; k++) {
+        inverse[order0[k]] = k;
+    }
+    vector<int> upperOuter;
+    vector<int> upperInner;
+    vector<int> parent;
+    PermutedTriangles(A, inverse, aOuter, aInner, aSlot, upperOuter, upperInner);
+    EliminationTree(n, upperOuter, upperInner, parent);
+
+    vector<int> post;
+    Postorder(n, parent, post);
+    order.resize(n);
+    for(int k = 0; k < n; k++) {
+        order[k] = order0[post[k]];
+        inverse[order[k]] = k;
+    }
+    PermutedTriangles(A, inverse, aOuter, aInner, aSlot, upperOuter, upperInner);
+    EliminationTree(n, upperOuter, upperInner, parent);
+
+    // the number of non-zeros in every column of L. Row i of L has the nodes on the paths up the
+    // tree from the non-zeros of row i of A, until i.
+    vector<int> colCount(n, 1);
+    vector<int> mark(n, -1);
+    vector<int> numChildren(n, 0);
+    for(int i = 0; i < n; i++) {
+        mark[i] = i;
+        for(int p = upperOuter[i]; p < upperOuter[i + 1]; p++) {
+            for(int k = upperInner[p]; mark[k] != i; k = parent[k]) {
+                colCount[k]++;
+                mark[k] = i;
+            }
+        }
+        if(parent[i] != -1) {
+            numChildren[parent[i]]++;
+        }
+    }
+
+    // fundamental supernodes: chains of columns with the same structure, below the diagonal.
+    vector<int> first;
+    for(int j = 0; j < n; j++) {
+        if(j == 0 || parent[j - 1] != j || colCount[j - 1] != colCount[j] + 1 || numChildren[j] != 1) {
+            first.push_back(j);
+        }
+    }
+    first.push_back(n);
+    const int numFundamental = first.size() - 1;
+    vector<int> superOf(n);
+    for(int s = 0; s < numFundamental; s++) {
+        std::fill(superOf.begin() + first[s], superOf.begin() + first[s + 1], s);
+    }
+
+    // the rows below the columns of every fundamental supernode, which are the rows of A
+    // below its columns, and the rows of its children below its columns.
+    vector<int> fundamentalChildOffsets(numFundamental + 1, 0);
+    for(int s = 0; s < numFundamental; s++) {
+        const int p = parent[first[s + 1] - 1];
+        if(p != -1) {
+            fundamentalChildOffsets[superOf[p] + 1]++;
+        }
+    }
+    for(int s = 0; s < numFundamental; s++) {
+        fundamentalChildOffsets[s + 1] += fundamentalChildOffsets[s];
+    }
+    vector<int> fundamentalChildren(fundamentalChildOffsets[numFundamental]);
+    {
+        vector<int> next(fundamentalChildOffsets.begin(), fundamentalChildOffsets.end() - 1);
+        for(int s = 0; s < numFundamental; s++) {
+            const int p = parent[first[s + 1] - 1];
+            if(p != -1) {
+                fundamentalChildren[next[superOf[p]]++] = s;
+            }
+        }
+    }
+    vector<int> belowOffsets(1, 0);
+    vector<int> below;
+    std::fill(mark.begin(), mark.end(), -1);
+    for(int s = 0; s < numFundamental; s++) {
+        const int last = first[s + 1] - 1;
+        const int begin = below.size();
+        for(int j = first[s]; j <= last; j++) {
+            for(int p = aOuter[j]; p < aOuter[j + 1]; p++) {
+                const int i = aInner[p];
+                if(i > last && mark[i] != s) {
+                    mark[i] = s;
+                    below.push_back(i);
+                }
+            }
+        }
+        for(int c = fundamentalChildOffsets[s]; c < fundamentalChildOffsets[s + 1]; c++) {
+            const int child = fundamentalChildren[c];
+            for(int p = belowOffsets[child]; p < belowOffsets[child + 1]; p++) {
+                const int i = below[p];
+                if(i > last && mark[i] != s) {
+                    mark[i] = s;
+                    below.push_back(i);
+                }
+            }
+        }
+        std::sort(below.begin() + begin, below.end());
+        belowOffsets.push_back(below.size());
+    }
+
+    // relaxed supernodes: the last child of a supernode comes right before it in the postorder,
+    // and can be merged into it. The merged supernode has the rows below its parent.
+    superFirst.clear();
+    vector<int> top; // the fundamental supernode at the top of every supernode.
+    vector<double> nonZeros;
+    for(int s = 0; s < numFundamental; s++) {
+        double columnNonZeros = 0;
+        for(int j = first[s]; j < first[s + 1]; j++) {
+            columnNonZeros += colCount[j];
+        }
+        int begin = first[s];
+        if(!top.empty()) {
+            const int previous = top.size() - 1;
+            const int previousLast = first[s] - 1;
+            if(parent[previousLast] == first[s]) {
+                const double width = first[s + 1] - superFirst[previous];
+                const double rows = width + belowOffsets[s + 1] - belowOffsets[s];
+                const double dense = width * rows - width * (width - 1) / 2;
+                const double zeros = (dense - nonZeros[previous] - columnNonZeros) / dense;
+                bool merge = zeros <= MAX_ZEROS;
+                for(int r = 0; r < 3; r++) {
+                    merge = merge || (width <= RELAXED_WIDTHS[r] && zeros <= RELAXED_ZEROS[r]);
+                }
+                if(merge) {
+                    begin = superFirst[previous];
+                    columnNonZeros += nonZeros[previous];
+                    superFirst.pop_back();
+                    top.pop_back();
+                    nonZeros.pop_back();
+                }
+            }
+        }
+        superFirst.push_back(begin);
+        top.push_back(s);
+        nonZeros.push_back(columnNonZeros);
+    }
+    superFirst.push_back(n);
+
+    const int numSupernodes = top.size();
+    for(int s = 0; s < numSupernodes; s++) {
+        std::fill(superOf.begin() + superFirst[s], superOf.begin() + superFirst[s + 1], s);
+    }
+    superParent.resize(numSupernodes);
+    rowOffsets.assign(1, 0);
+    rowIndices.clear();
+    valueOffsets.assign(1, 0);
+    factorNonZeros = 0;
+    for(int s = 0; s < numSupernodes; s++) {
+        const int p = parent[superFirst[s + 1] - 1];
+        superParent[s] = p == -1 ? -1 : superOf[p];
+        for(int j = superFirst[s]; j < superFirst[s + 1]; j++) {
+            rowIndices.push_back(j);
+        }
+        rowIndices.insert(rowIndices.end(), below.begin() + belowOffsets[top[s]], below.begin() + belowOffsets[top[s] + 1]);
+        rowOffsets.push_back(rowIndices.size());
+
+        const size_t width = superFirst[s + 1] - superFirst[s];
+        const size_t rows = rowOffsets[s + 1] - rowOffsets[s];
+        valueOffsets.push_back(valueOffsets[s] + width * rows);
+        factorNonZeros += width * rows - width * (width - 1) / 2;
+    }
+    values.resize(valueOffsets[numSupernodes]);
+
+    childOffsets.assign(numSupernodes + 1, 0);
+    for(int s = 0; s < numSupernodes; s++) {
+        if(superParent[s] != -1) {
+            childOffsets[superParent[s] + 1]++;
+        }
+    }
+    for(int s = 0; s < numSupernodes; s++) {
+        childOffsets[s + 1] += childOffsets[s];
+    }
+    children.resize(childOffsets[numSupernodes]);
+    vector<int> next(childOffsets.begin(), childOffsets.end() - 1);
+    for(int s = 0; s < numSupernodes; s++) {
+        if(superParent[s] != -1) {
+            children[next[superParent[s]]++] = s;
+        }
+    }
+}
+
+bool SupernodalCholesky::FactorSupernode(int s, const double* Ax, Front& front, Workers& workers) {
+    const int f = superFirst[s];
+    const int w = superFirst[s + 1] - f;
+    const int* rows = rowIndices.data() + rowOffsets[s];
+    const int m = rowOffsets[s + 1] - rowOffsets[s];
+    const int b = m - w;
+
+    for(int i = 0; i < m; i++) {
+        front.map[rows[i]] = i;
+    }
+    if(front.buffer.size() < (size_t)m * m) {
+        front.buffer.resize((size_t)m * m);
+    }
+    Eigen::Map<Eigen::MatrixXd> F(front.buffer.data(), m, m);
+    F.triangularView<Eigen::Lower>().setZero();
+
+    // the columns of A, and the updates of the children.
+    for(int j = 0; j < w; j++) {
+        for(int p = aOuter[f + j]; p < aOuter[f + j + 1]; p++) {
+            F(front.map[aInner[p]], j) += Ax[aSlot[p]];
+        }
+    }
+    for(int c = childOffsets[s]; c < childOffsets[s + 1]; c++) {
+        const int child = children[c];
+        const int* childRows = rowIndices.data() + rowOffsets[child] + (superFirst[child + 1] - superFirst[child]);
+        Eigen::MatrixXd& U = updates[child];
+        for(int jj = 0; jj < U.cols(); jj++) {
+            const int j = front.map[childRows[jj]];
+            for(int ii = jj; ii < U.rows(); ii++) {
+                F(front.map[childRows[ii]], j) += U(ii, jj);
+            }
+        }
+        U = Eigen::MatrixXd();
+    }
+
+    Eigen::Block< Eigen::Map<Eigen::MatrixXd> > F11 = F.topLeftCorner(w, w);
+    Eigen::LLT< Eigen::Ref<Eigen::MatrixXd> > llt(F11);
+    if(llt.info() != Eigen::Success) {
+        return false;
+    }
+
+    if(b > 0) {
+        // L21 = F21 * L11^-T, and then F22 -= L21 * L21^T, in blocks that are independent of each other.
+        Eigen::Block< Eigen::Map<Eigen::MatrixXd> > L21 = F.bottomLeftCorner(b, w);
+        Eigen::Block< Eigen::Map<Eigen::MatrixXd> > F22 = F.bottomRightCorner(b, b);
+        const int numBlocks = (b + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        std::function<void(int)> solveBlock = [&](int k) {
+            const int r = k * BLOCK_SIZE;
+            const int size = std::min(BLOCK_SIZE, b - r);
+            F11.triangularView<Eigen::Lower>().transpose().solveInPlace<Eigen::OnTheRight>(L21.middleRows(r, size));
+        };
+        std::function<void(int)> updateBlock = [&](int k) {
+            const int c = k * BLOCK_SIZE;
+            const int size = std::min(BLOCK_SIZE, b - c);
+            F22.block(c, c, size, size).triangularView<Eigen::Lower>() -= L21.middleRows(c, size) * L21.middleRows(c, size).transpose();
+            if(c + size < b) {
+                F22.block(c + size, c, b - c - size, size).noalias() -= L21.bottomRows(b - c - size) * L21.middleRows(c, size).transpose();
+            }
+        };
+
+        if(b >= PARALLEL_FRONT_SIZE) {
+            workers.Split(numBlocks, solveBlock);
+            workers.Split(numBlocks, updateBlock);
+        } else {
+            for(int k = 0; k < numBlocks; k++) {
+                solveBlock(k);
+            }
+            for(int k = 0; k < numBlocks; k++) {
+                updateBlock(k);
+            }
+        }
+        updates[s] = F22;
+    }
+
+    Eigen::Map<Eigen::MatrixXd>(values.data() + valueOffsets[s], m, w) = F.leftCols(w);
+    return true;
+}
+
+void SupernodalCholesky::factorize(const SparseMatrix& A) {
+    const int numSupernodes = NumSupernodes();
+    const double* Ax = A.valuePtr();
+    updates.assign(numSupernodes, Eigen::MatrixXd());
+
+    // a supernode is ready once all its children are done.
+    const int numWorkers = std::max(1, std::min(numThreads, numSupernodes));
+    Workers workers;
+    workers.numThreads = numWorkers;
+    workers.pending.resize(numSupernodes);
+    workers.numDone = 0;
+    workers.failed = false;
+    for(int s = 0; s < numSupernodes; s++) {
+        workers.pending[s] = childOffsets[s + 1] - childOffsets[s];
+        if(workers.pending[s] == 0) {
+            workers.ready.push_back(s);
+        }
+    }
+
+    vector<Front> fronts(numWorkers);
+
+    auto work = [&](int worker) {
+        Front& front = fronts[worker];
+        front.map.resize(n);
+        for(;;) {
+            int s;
+            {
+                std::unique_lock<std::mutex> lock(workers.mutex);
+                workers.changed.wait(lock, [&] {
+                    return !workers.ready.empty() || !workers.jobs.empty() || workers.numDone == numSupernodes || workers.failed;
+                });
+                if(workers.numDone == numSupernodes || workers.failed) {
+                    return;
+                }
+
+                // no supernode is ready, so help the front that is waiting the longest for its blocks.
+                if(workers.ready.empty()) {
+                    BlockJob& job = *workers.jobs.front();
+                    job.numHelpers++;
+                    lock.unlock();
+                    const int count = Workers::RunBlocks(job);
+                    lock.lock();
+
+                    // every block has been taken now.
+                    workers.jobs.erase(std::remove(workers.jobs.begin(), workers.jobs.end(), &job), workers.jobs.end());
+                    job.numFinished += count;
+                    job.numHelpers--;
+                    lock.unlock();
+                    workers.changed.notify_all();
+                    continue;
+                }
+
+                s = workers.ready.back();
+                workers.ready.pop_back();
+            }
+            const bool factored = FactorSupernode(s, Ax, front, workers);
+            {
+                std::lock_guard<std::mutex> lock(workers.mutex);
+                workers.failed = workers.failed || !factored;
+                workers.numDone++;
+                if(superParent[s] != -1 && --workers.pending[superParent[s]] == 0) {
+                    workers.ready.push_back(superParent[s]);
+                }
+            }
+            workers.changed.notify_all();
+        }
+    };
+
+    vector<std::thread> threads;
+    for(int i = 1; i < numWorkers; i++) {
+        threads.push_back(std::thread(work, i));
+    }
+    work(0);
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    updates.clear();
+    status = workers.failed ? Eigen::NumericalIssue : Eigen::Success;
+}
+
+void SupernodalCholesky::Solve(const double* B, double* X, int K) {
+    Eigen::MatrixXd Y(n, K);
+    for(int c = 0; c < K; c++) {
+        for(int k = 0; k < n; k++) {
+            Y(k, c) = B[(size_t)c * n + order[k]];
+        }
+    }
+
+    // L * Z = Y, and then L^T * Y = Z, one supernode at a time.
+    Eigen::MatrixXd below;
+    const int numSupernodes = NumSupernodes();
+    for(int s = 0; s < numSupernodes; s++) {
+        const int f = superFirst[s];
+        const int w = superFirst[s + 1] - f;
+        const int* rows = rowIndices.data() + rowOffsets[s];
+        const int b = rowOffsets[s + 1] - rowOffsets[s] - w;
+        Eigen::Map<const Eigen::MatrixXd> L(values.data() + valueOffsets[s], w + b, w);
+
+        L.topRows(w).triangularView<Eigen::Lower>().solveInPlace(Y.middleRows(f, w));
+        if(b > 0) {
+            below.noalias() = L.bottomRows(b) * Y.middleRows(f, w);
+            for(int i = 0; i < b; i++) {
+                Y.row(rows[w + i]) -= below.row(i);
+            }
+        }
+    }
+    for(int s = numSupernodes - 1; s >= 0; s--) {
+        const int f = superFirst[s];
+        const int w = superFirst[s + 1] - f;
+        const int* rows = rowIndices.data() + rowOffsets[s];
+        const int b = rowOffsets[s + 1] - rowOffsets[s] - w;
+        Eigen::Map<const Eigen::MatrixXd> L(values.data() + valueOffsets[s], w + b, w);
+
+        if(b > 0) {
+            below.resize(b, K);
+            for(int i = 0; i < b; i++) {
+                below.row(i) = Y.row(rows[w + i]);
+            }
+            Y.middleRows(f, w).noalias() -= L.bottomRows(b).transpose() * below;
+        }
+        L.topRows(w).transpose().triangularView<Eigen::Upper>().solveInPlace(Y.middleRows(f, w));
+    }
+
+    for(int c = 0; c < K; c++) {
+        for(int k = 0; k < n; k++) {
+            X[(size_t)c * n + order[k]] = Y(k, c);
+        }
+    }
+}
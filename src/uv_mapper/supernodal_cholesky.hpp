@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include "direct_solver.hpp"
+
+//
+// Multithreaded supernodal Cholesky factorization A = L * L^T, for symmetric positive
+// definite matrices, stored in full.
+//
+// analyzePattern orders A with the nested dissection of the mesh, computes the elimination
+// tree, and groups columns of L with the same structure into supernodes, which are dense
+// blocks of columns. A child supernode that adds few zeros to its parent is merged into it,
+// so that the leaves of the tree are not split into tiny blocks.
+//
+// factorize is multifrontal: every supernode gathers its columns of A and the update
+// matrices of its children into a dense frontal matrix, factors its columns with dense
+// Eigen blocks, and leaves an update matrix for its parent. A supernode only depends on its
+// children, so the supernodes are run as tasks on a pool of threads as soon as all their children
+// are done, which runs independent subtrees in parallel. The large fronts near the root, where
+// there are few tasks left, split their dense updates into blocks, and the threads that have no
+// supernode to factor help with them. So the factorization never runs more than numThreads threads.
+//
+// The children are always added in the same order, and the dense blocks are always split the
+// same way, so the factor is the same for any number of threads.
+//
+class SupernodalCholesky : public SparseDirectSolver {
+public:
+    SupernodalCholesky();
+
+    const char* Name() const { return "supernodal"; }
+    void SetNumThreads(int numThreads) { this->numThreads = numThreads; }
+
+    void analyzePattern(const SparseMatrix& A);
+    void factorize(const SparseMatrix& A);
+    Eigen::ComputationInfo info() const { return status; }
+
+    void Solve(const double* B, double* X, int K);
+
+    size_t FactorNonZeros() const { return factorNonZeros; }
+
+    int NumSupernodes() const { return superFirst.size() - 1; }
+
+private:
+    struct Front;
+    struct Workers;
+
+    bool FactorSupernode(int s, const double* Ax, Front& front, Workers& workers);
+
+    int n;
+    int numThreads;
+    Eigen::ComputationInfo status;
+
+    // order[k] is the column of A that is eliminated k-th.
+    std::vector<int> order;
+
+    // the lower triangle of A in the elimination order, as compressed columns. aSlot is where
+    // in A.valuePtr() every element is.
+    std::vector<int> aOuter;
+    std::vector<int> aInner;
+    std::vector<int> aSlot;
+
+    // supernode s has the columns [superFirst[s], superFirst[s+1]), and its rows are
+    // rowIndices[rowOffsets[s]] to rowIndices[rowOffsets[s+1]], sorted, starting with
+    // its own columns. Its block of L is stored in values, column-major, from valueOffsets[s].
+    std::vector<int> superFirst;
+    std::vector<int> superParent; // -1 at the roots.
+    std::vector<int> rowOffsets;
+    std::vector<int> rowIndices;
+    std::vector<size_t> valueOffsets;
+    std::vector<double> values;
+    size_t factorNonZeros; // not counting the zeros above the diagonal of every block.
+
+    // the children of supernode s are children[childOffsets[s]] to children[childOffsets[s+1]].
+    std::vector<int> childOffsets;
+    std::vector<int> children;
+
+    // the update matrices that supernodes leave for their parents.
+    std::vector<Eigen::MatrixXd> updates;
+};
@@ -1,276 +1,1402 @@
 #include "uv_mapper.hpp"
+#include "uv_mapper_internal.hpp"
 
-#include "half_edge_mesh.hpp"
+#include "indexed_half_edge_mesh.hpp"
+#include "parallel.hpp"
+#include "buffer.hpp"
+#include "linear_solvers.hpp"
+#include "multigrid.hpp"
+#include "cotangents.hpp"
+#include "nested_dissection.hpp"
+#include "direct_solver.hpp"
+#include "domain_decomposition.hpp"
+#include "matrix_free_cg.hpp"
+#include "mesh_simplification.hpp"
 #include "vec.hpp"
 
 #include "Eigen/Sparse"
+#ifdef AUTO_UV_USE_METIS
+#include "Eigen/MetisSupport"
+#endif
 
-#include <set>
 #include <iostream>
 
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
 #define M_PI 3.14159
 
 using std::vector;
-using std::set;
 
-/*
+// the vertex positions stored in the half edge mesh.
+struct MeshPositions {
+    const IndexedHalfEdgeMesh& hem;
+    MeshPositions(const IndexedHalfEdgeMesh& hem) : hem(hem) {}
+    vec3 operator()(VertexIndex v) const { return hem.Position(v); }
+};
 
-           /\
-         / u \
-     b1/      \a1
-     /     c   \
-   / -----------\
-   \            /
-    \         /
-   a2\      /b2
-      \ v /
-       \/
+// vertex positions stored as xyz-triples, like the input of uvMap.
+struct ArrayPositions {
+    const float* positions;
+    ArrayPositions(const float* positions) : positions(positions) {}
+    vec3 operator()(VertexIndex v) const {
+        return vec3(positions[3 * v + 0], positions[3 * v + 1], positions[3 * v + 2]);
+    }
+};
 
-Compute the harmonic weight for the edge.
+// below this, it is not worth starting a thread.
+static const size_t MIN_CHUNK_SIZE = 1 << 14;
 
-It is computed by the formula
+// the number of threads to use for options.numThreads.
+static int NumThreads(const UvMapOptions& options) {
+    return options.numThreads > 0 ? options.numThreads : NumHardwareThreads();
+}
 
-(cot(u) + cot(v)) / 2
+typedef std::chrono::steady_clock Clock;
 
-see the beautiful ASCII art above for an illustration.
-*/
+static double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The sparsity pattern that a solver was last analyzed for, and how long that took.
+struct SymbolicAnalysis {
+    bool valid;
+    uint64_t pattern;
+    double milliseconds;
 
-float HarmonicWeight(EdgeIter eit) {
-    // length of edge shared by the two triangles.
-    float c = eit->GetLength();
+    SymbolicAnalysis() : valid(false), pattern(0), milliseconds(0.0) {}
+};
 
-    HalfEdgeIter e = eit->halfEdge;
-    float a1 = vec3::distance(e->next->vertex->p, e->next->next->vertex->p );
-    float b1 = vec3::distance(e->next->next->vertex->p, e->next->next->next->vertex->p );
+// The direct solvers with one fill-reducing ordering. Every ordering has solvers of
+// its own, so that each keeps its own symbolic analysis. The Cholesky factorizations and
+// LU need the ordering as permutations in opposite directions, see InverseOrdering.
+template<typename CholeskyOrdering, typename LuOrdering>
+struct DirectSolvers {
+    typedef Eigen::SimplicialLDLT<SparseMatrix, Eigen::Lower, CholeskyOrdering> Cholesky;
+    typedef Eigen::SparseLU<SparseMatrix, LuOrdering> Lu;
 
-    e = eit->halfEdge->twin;
-    float a2 = vec3::distance(e->next->vertex->p, e->next->next->vertex->p );
-    float b2 = vec3::distance(e->next->next->vertex->p, e->next->next->next->vertex->p );
+    Cholesky cholesky;
+    Eigen::SimplicialLDLT<SparseMatrixF, Eigen::Lower, CholeskyOrdering> choleskyFloat;
+    Lu lu;
 
-    // use the cosine law to compute cos(u) and cos(v)
-    float cos_u = (b1*b1 + a1*a1 - c*c) / (2.0f * b1 * a1);
-    float cos_v = (b2*b2 + a2*a2 - c*c) / (2.0f * b2 * a2);
+    SymbolicAnalysis choleskyAnalysis;
+    SymbolicAnalysis choleskyFloatAnalysis;
+    SymbolicAnalysis luAnalysis;
+};
 
-    float sin_u = sqrt(1.0 - cos_u*cos_u);
-    float sin_v = sqrt(1.0 - cos_v*cos_v);
+//
+// All the memory used while uv mapping a mesh. Everything is kept
+// between calls, so that it can be reused.
+//
+struct UvMapWorkspace::Buffers {
+    IndexedHalfEdgeMesh mesh;
 
-    float weight;
-    weight = (cos_u / sin_u + cos_v  / sin_v) * 0.5f;
+    vector<VertexIndex> boundaryVertices;
+    vector<float> edgeLengths; // cumulative edge lengths
+    vector<char> isFixed; // whether x[i] is already known.
+    vector<uint32_t> unknownIndex; // the index of every vertex among the unknowns.
+
+    vector<float> faceCotangents; // the cotangents of the three angles of every face, for every set of positions.
+    vector<float> edgeWeights; // the harmonic weight of every edge, for every set of positions.
+    vector<int> edgeSlots; // where in W.valuePtr() the weights of every edge go.
+    vector<int> diagSlots; // where in W.valuePtr() the diagonal goes.
+    SparseMatrix W; // W is very sparse, so much can be saved by using a sparse matrix.
+    uint64_t pattern; // SparsityPatternHash(W)
+    SparseMatrixF Wf; // W in single precision, for the mixed precision solver.
+    uint64_t floatPattern; // the pattern of W that Wf was last converted from.
+
+    // the right hand sides and the solutions of the linear system, as column-major
+    // matrices with one column for each uv coordinate.
+    vector<double> rhs;
+    vector<double> solution;
+    vector<double> solveWork;
+    vector<double> residuals;
+    vector<float> rhsFloat;
+    vector<float> solveWorkFloat;
+
+    vector<double> x;
+    vector<double> y;
+
+    DirectSolvers<Eigen::AMDOrdering<int>, InverseOrdering<Eigen::AMDOrdering<int> > > amd;
+    DirectSolvers<InverseOrdering<Eigen::COLAMDOrdering<int> >, Eigen::COLAMDOrdering<int> > colamd;
+    DirectSolvers<NestedDissectionOrdering, InverseOrdering<NestedDissectionOrdering> > nestedDissection;
+#ifdef AUTO_UV_USE_METIS
+    DirectSolvers<Eigen::MetisOrdering<int>, InverseOrdering<Eigen::MetisOrdering<int> > > metis;
+#endif
+
+    // W is stored in full, so the solvers can multiply with it directly,
+    // instead of going through a selfadjoint view.
+    Eigen::ConjugateGradient<SparseMatrix, Eigen::Lower | Eigen::Upper,
+        Eigen::DiagonalPreconditioner<double> > cgDiagonal;
+    Eigen::ConjugateGradient<SparseMatrix, Eigen::Lower | Eigen::Upper,
+        Eigen::IncompleteCholesky<double> > cgIncompleteCholesky;
+    Eigen::ConjugateGradient<SparseMatrix, Eigen::Lower | Eigen::Upper,
+        AlgebraicMultigrid> cgMultigrid;
+    AlgebraicMultigrid multigrid;
+
+    // the backend last asked for by options.backend, if this build has it.
+    std::unique_ptr<SparseDirectSolver> backend;
+
+    DomainDecomposition domainDecomposition;
+
+    // W is never built for it, only its diagonal.
+    MatrixFreeConjugateGradient matrixFree;
+
+    // the simplified mesh of UvMapOptions::coarseVertices, which is mapped with its own buffers,
+    // and its uvs, and those interpolated to all the vertices.
+    MeshSimplifier simplifier;
+    std::unique_ptr<UvMapWorkspace> coarse;
+    vector<float> coarseUvs;
+    vector<float> previewUvs;
 
-    return weight;
+    SymbolicAnalysis backendAnalysis;
+    SymbolicAnalysis domainDecompositionAnalysis;
+    SymbolicAnalysis cgDiagonalAnalysis;
+    SymbolicAnalysis cgIncompleteCholeskyAnalysis;
+    SymbolicAnalysis cgMultigridAnalysis;
+
+    // when the iterative solvers have to stop, see UvMapOptions::timeBudgetMilliseconds.
+    Clock::time_point deadline;
+
+    // the flag of the uvMapAsync job that the call runs for, if any, which cancels the call
+    // just like UvMapOptions::cancel. See uvMapCancellable.
+    const std::atomic<bool>* jobCancel;
+
+    size_t numAllocations;
+
+    Buffers() : pattern(0), floatPattern(0), deadline(Clock::time_point::max()), jobCancel(NULL), numAllocations(0) {}
+};
+
+// Whether the call has been cancelled, see UvMapOptions::cancel.
+static bool Cancelled(const UvMapWorkspace::Buffers& ws, const UvMapOptions& options) {
+    return (options.cancel && options.cancel->load()) || (ws.jobCancel && ws.jobCancel->load());
 }
 
-void uvMap(
-    const std::vector<float>& inVertices,
-    const std::vector<int>& inFaces,
+// Reports the start of the stage to options.progress. Returns false if the call has been
+// cancelled, and has to stop instead.
+static bool EnterStage(const UvMapWorkspace::Buffers& ws, const UvMapOptions& options, UvMapStage stage) {
+    if(Cancelled(ws, options)) {
+        return false;
+    }
+    if(options.progress) {
+        options.progress(stage, options.progressUserData);
+    }
+    return true;
+}
 
-    std::vector<float>& outVertices,
-    std::vector<int>& outFaces,
-    std::vector<float>& outUvs,
-    std::vector<float>* outUvEdges
-    ) {
+UvMapWorkspace::UvMapWorkspace() : buffers(new Buffers()) {
+}
 
-    vector<vec3> vVertices;
-    for(int i = 0; i < inVertices.size(); i+=3) {
-        vVertices.push_back(vec3(
-                                inVertices[i+0],
-                                inVertices[i+1],
-                                inVertices[i+2]
-                                ));
+UvMapWorkspace::~UvMapWorkspace() {
+}
+
+size_t UvMapWorkspace::NumAllocations() const {
+    return buffers->numAllocations + buffers->mesh.NumAllocations() + buffers->matrixFree.NumAllocations() +
+        buffers->simplifier.NumAllocations() + (buffers->coarse ? buffers->coarse->NumAllocations() : 0);
+}
+
+// Computes the decomposition of A with the solver, just like solver.compute(A). But the
+// symbolic analysis is skipped if the solver was last analyzed for the same sparsity pattern.
+template<typename Solver, typename Matrix>
+static void Decompose(
+    Solver& solver, SymbolicAnalysis& analysis, const Matrix& A, uint64_t pattern, UvMapStats& stats) {
+    if(analysis.valid && analysis.pattern == pattern) {
+        stats.savedMilliseconds += analysis.milliseconds;
+    } else {
+        Clock::time_point start = Clock::now();
+        solver.analyzePattern(A);
+        analysis.milliseconds = MillisecondsSince(start);
+        analysis.pattern = pattern;
+        analysis.valid = true;
+        stats.analyzeMilliseconds += analysis.milliseconds;
     }
 
-    vector<Tri> vFaces;
-    for(int i = 0; i < inFaces.size(); i+=3) {
-        vFaces.push_back(Tri(
-                             inFaces[i+0],
-                             inFaces[i+1],
-                             inFaces[i+2]
-                             ));
+    Clock::time_point start = Clock::now();
+    solver.factorize(A);
+    stats.factorizeMilliseconds += MillisecondsSince(start);
+}
+
+// the same, for W.
+template<typename Solver>
+static void Decompose(
+    Solver& solver, SymbolicAnalysis& analysis, UvMapWorkspace::Buffers& ws, UvMapStats& stats) {
+    Decompose(solver, analysis, ws.W, ws.pattern, stats);
+}
+
+// Solves the linear system in the workspace with an iterative solver, starting from
+// the current solution. Returns false if the preconditioner could not be computed. If
+// the call is cancelled once the preconditioner is set up, it is not solved, and if it
+// is cancelled during the iterations, they stop after the current one.
+template<typename Solver>
+static bool SolveIterative(
+    Solver& solver, SymbolicAnalysis& analysis, UvMapWorkspace::Buffers& ws, const UvMapOptions& options, int K, UvMapStats& stats) {
+    const int M = ws.W.rows();
+
+    Decompose(solver, analysis, ws, stats);
+    if(solver.info() != Eigen::Success) {
+        return false;
+    }
+    if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+        return true;
     }
 
-    // instead of a polygon soup, we use a half edge mesh.
-    HalfEdgeMesh hem(vVertices, vFaces);
+    // every column is iterated until it converges by itself, with the preconditioner of the
+    // solver, but with iterations of its own, which can be cancelled.
+    const int maxIterations = options.maxIterations > 0 ? options.maxIterations : 2 * M;
+    for(int c = 0; c < K; c++) {
+        int iterations;
+        double residual;
+        const bool converged = SolveConjugateGradient(
+            ws.W, solver.preconditioner(), ws.rhs.data() + c * M, ws.solution.data() + c * M, options.tolerance,
+            maxIterations, [&]() { return Cancelled(ws, options); }, iterations, residual);
+        stats.iterations = std::max(stats.iterations, iterations);
+        stats.residual = std::max(stats.residual, residual);
+        stats.converged = stats.converged && converged;
+    }
+    return true;
+}
 
-    // To now find the uv coordinates, we will create a system of
-    // linear equations. The system is formulated with matrices and vectors,
-    // and then we solve it with Eigen.
+// the largest residual |B - W*X| / |B| of the K columns, where R = B - W*X.
+static double MaxResidual(const Eigen::MatrixXd::ConstMapType& B, const Eigen::MatrixXd::MapType& R) {
+    double residual = 0.0;
+    for(int c = 0; c < B.cols(); c++) {
+        const double bNorm = B.col(c).norm();
+        if(bNorm > 0.0) {
+            residual = std::max(residual, R.col(c).norm() / bNorm);
+        }
+    }
+    return residual;
+}
+
+// when maxIterations is 0.
+static const int MAX_REFINEMENT_STEPS = 10;
+
+//
+// Solves the linear system in the workspace with the LDL^T factorization of W in single
+// precision, and then iterative refinement: the residual of the solution is computed against
+// W in double precision, the factorization solves for the error of the solution, and the error
+// is subtracted, until the residual is below the tolerance. Every step gains about as many digits
+// as the single precision solve is accurate to, so a couple of steps give double precision.
+//
+// Returns false if the factorization fails, or if a step does not reduce the residual, which
+// happens when W is too ill-conditioned for single precision. The solve stage is only entered
+// once the refinement has succeeded, so a fallback to double precision still reports the
+// factorization stage followed by one solve stage.
+//
+template<typename Solvers>
+static bool SolveMixedPrecision(
+    Solvers& solvers, UvMapWorkspace::Buffers& ws, const UvMapOptions& options, int K, UvMapStats& stats) {
+    const int M = ws.W.rows();
+    Eigen::MatrixXd::ConstMapType B(ws.rhs.data(), M, K);
+    Eigen::MatrixXd::MapType X(ws.solution.data(), M, K);
+
+    // Wf has the same pattern as W, so as long as that is unchanged, only the values are converted.
+    if(ws.floatPattern != ws.pattern || ws.Wf.rows() != M || ws.Wf.nonZeros() != ws.W.nonZeros()) {
+        ws.Wf = ws.W.cast<float>();
+        ws.floatPattern = ws.pattern;
+    } else {
+        const double* values = ws.W.valuePtr();
+        float* floatValues = ws.Wf.valuePtr();
+        for(int p = 0; p < ws.W.nonZeros(); p++) {
+            floatValues[p] = (float)values[p];
+        }
+    }
+
+    Decompose(solvers.choleskyFloat, solvers.choleskyFloatAnalysis, ws.Wf, ws.pattern, stats);
+    if(solvers.choleskyFloat.info() != Eigen::Success || solvers.choleskyFloat.vectorD().minCoeff() <= 0.0f) {
+        return false;
+    }
+    stats.factorNonZeros = solvers.choleskyFloat.matrixL().nestedExpression().nonZeros() + M;
+
+    ResizeBuffer(ws.residuals, M * K, ws.numAllocations);
+    ResizeBuffer(ws.rhsFloat, M * K, ws.numAllocations);
+    ResizeBuffer(ws.solveWorkFloat, M * K, ws.numAllocations);
+    Eigen::MatrixXd::MapType R(ws.residuals.data(), M, K);
+    Eigen::MatrixXf::MapType E(ws.rhsFloat.data(), M, K);
+
+    const int maxSteps = options.maxIterations > 0 ? options.maxIterations : MAX_REFINEMENT_STEPS;
+
+    // the first solve is a refinement step from X = 0.
+    X.setZero();
+    R = B;
+    double residual = MaxResidual(B, R);
+    int iterations = 0;
+    for(int step = 0; residual > options.tolerance && step < maxSteps && !Cancelled(ws, options); step++) {
+        E = R.cast<float>();
+        SolveLdltBlocked(solvers.choleskyFloat, ws.rhsFloat.data(), ws.rhsFloat.data(), K, ws.solveWorkFloat.data());
+        X += E.cast<double>();
+
+        R.noalias() = ws.W * X;
+        R = B - R;
+        const double newResidual = MaxResidual(B, R);
+        if(newResidual >= residual) {
+            return false;
+        }
+        residual = newResidual;
+        iterations = step + 1;
+    }
+    if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+        return true;
+    }
+    stats.iterations = iterations;
+    stats.residual = residual;
+    stats.converged = residual <= options.tolerance;
+    return true;
+}
+
+// Solves the linear system in the workspace with the direct solvers, for all K columns of the
+// right hand side. The Cholesky factorizations use the first solvers, and LU the second.
+// Returns false if even LU finds no decomposition.
+template<typename CholeskySolvers, typename LuSolvers>
+static bool SolveDirect(
+    CholeskySolvers& choleskySolvers,
+    LuSolvers& luSolvers,
+    UvMapWorkspace::Buffers& ws,
+    const UvMapOptions& options,
+    int K,
+    UvMapStats& stats) {
+
+    const int M = ws.W.rows();
+    Eigen::MatrixXd::ConstMapType B(ws.rhs.data(), M, K);
+    Eigen::MatrixXd::MapType X(ws.solution.data(), M, K);
+
+    if(options.solver == UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY &&
+       SolveMixedPrecision(choleskySolvers, ws, options, K, stats)) {
+        return true;
+    }
+
+    if(options.solver == UV_MAP_SOLVER_CHOLESKY || options.solver == UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY) {
+        // W should be positive definite, which means that all of D should be
+        // positive. If not (say, because of degenerate triangles), we fall back to LU.
+        typename CholeskySolvers::Cholesky& cholesky = choleskySolvers.cholesky;
+        Decompose(cholesky, choleskySolvers.choleskyAnalysis, ws, stats);
+        if(cholesky.info() == Eigen::Success && cholesky.vectorD().minCoeff() > 0.0) {
+            stats.factorNonZeros = cholesky.matrixL().nestedExpression().nonZeros() + M;
+            if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+                return true;
+            }
+            ResizeBuffer(ws.solveWork, M * K, ws.numAllocations);
+            SolveLdltBlocked(cholesky, ws.rhs.data(), ws.solution.data(), K, ws.solveWork.data());
+            return true;
+        }
+    }
+
+    typename LuSolvers::Lu& lu = luSolvers.lu;
+    Decompose(lu, luSolvers.luAnalysis, ws, stats);
+    if(lu.info()!=Eigen::Success) {
+        return false;
+    }
+    // L is stored by supernodes, which also hold the diagonal blocks.
+    stats.factorNonZeros = lu.matrixL().m_mapL.colIndexPtr()[M] + lu.matrixU().m_mapU.nonZeros();
+    if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+        return true;
+    }
+
+    // the supernodal LU solve handles all the columns together.
+    X = lu.solve(B);
+    return true;
+}
+
+// Solves the linear system in the workspace with the backend named by options.backend.
+// Returns false if this build has no such backend, or if its factorization fails.
+static bool SolveBackend(UvMapWorkspace::Buffers& ws, const UvMapOptions& options, int K, UvMapStats& stats) {
+    if(strcmp(options.backend, "eigen") == 0) {
+        return false;
+    }
+    if(!ws.backend || strcmp(ws.backend->Name(), options.backend) != 0) {
+        ws.backend = CreateSparseDirectSolver(options.backend);
+        ws.backendAnalysis = SymbolicAnalysis();
+        if(!ws.backend) {
+            return false;
+        }
+    }
+
+    ws.backend->SetNumThreads(NumThreads(options));
+    Decompose(*ws.backend, ws.backendAnalysis, ws, stats);
+    if(ws.backend->info() != Eigen::Success) {
+        return false;
+    }
+    stats.backend = ws.backend->Name();
+    if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+        return true;
+    }
+    ws.backend->Solve(ws.rhs.data(), ws.solution.data(), K);
+    stats.factorNonZeros = ws.backend->FactorNonZeros();
+    return true;
+}
+
+// Solves the linear system in the workspace by domain decomposition.
+// Returns false if one of the factorizations fails.
+static bool SolveDomainDecomposition(UvMapWorkspace::Buffers& ws, const UvMapOptions& options, int K, UvMapStats& stats) {
+    DomainDecomposition& solver = ws.domainDecomposition;
+    // the partition depends on the number of subdomains, as well as on the pattern.
+    if(solver.MaxSubdomains() != options.numSubdomains) {
+        solver.SetNumSubdomains(options.numSubdomains);
+        ws.domainDecompositionAnalysis = SymbolicAnalysis();
+    }
+    solver.SetNumThreads(NumThreads(options));
+
+    Decompose(solver, ws.domainDecompositionAnalysis, ws, stats);
+    stats.numSubdomains = solver.NumSubdomains();
+    stats.separatorSize = solver.SeparatorSize();
+    stats.smallestSubdomain = solver.SmallestSubdomain();
+    stats.largestSubdomain = solver.LargestSubdomain();
+    stats.subdomainMilliseconds = solver.SubdomainMilliseconds();
+    stats.schurMilliseconds = solver.SchurMilliseconds();
+    if(solver.info() != Eigen::Success) {
+        return false;
+    }
+    if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+        return true;
+    }
+
+    Clock::time_point start = Clock::now();
+    solver.Solve(ws.rhs.data(), ws.solution.data(), K);
+    stats.solveMilliseconds = MillisecondsSince(start);
+    stats.factorNonZeros = solver.FactorNonZeros();
+    return true;
+}
+
+// Solves the linear system in the workspace, for all K columns of the right hand side.
+// The iterative solvers start from the solution already in the workspace. Returns false
+// if no solver could solve it. Every solver enters UV_MAP_STAGE_SOLVE once it has been
+// factorized or set up, and if the call has been cancelled by then, it is not solved.
+static bool SolveSystem(UvMapWorkspace::Buffers& ws, const UvMapOptions& options, int K, UvMapStats& stats) {
+    // there is no W to take the size from.
+    if(options.solver == UV_MAP_SOLVER_MATRIX_FREE_CONJUGATE_GRADIENT) {
+        if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+            return true;
+        }
+        const int M = ws.rhs.size() / K;
+        const int maxIterations = options.maxIterations > 0 ? options.maxIterations : 2 * M;
+        stats.converged = ws.matrixFree.Solve(
+            ws.rhs.data(), ws.solution.data(), options.tolerance, maxIterations, ws.deadline,
+            [&]() { return Cancelled(ws, options); }, stats.iterations, stats.residual);
+        return true;
+    }
+
+    const int M = ws.W.rows();
+
+    if(options.solver == UV_MAP_SOLVER_MULTIGRID) {
+        Clock::time_point start = Clock::now();
+        ws.multigrid.Setup(ws.W);
+        stats.factorizeMilliseconds += MillisecondsSince(start);
+        if(ws.multigrid.info() != Eigen::Success) {
+            return false;
+        }
+        if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+            return true;
+        }
+
+        const int maxIterations = options.maxIterations > 0 ? options.maxIterations : 2 * M;
+        for(int c = 0; c < K; c++) {
+            int iterations;
+            double residual;
+            ws.multigrid.Iterate(ws.rhs.data() + c * M, ws.solution.data() + c * M, options.tolerance, maxIterations,
+                [&]() { return Cancelled(ws, options); }, iterations, residual);
+            stats.iterations = std::max(stats.iterations, iterations);
+            stats.residual = std::max(stats.residual, residual);
+            stats.converged = stats.converged && residual <= options.tolerance;
+        }
+        return true;
+    }
+
+    if(options.solver == UV_MAP_SOLVER_CONJUGATE_GRADIENT) {
+        if(options.preconditioner == UV_MAP_PRECONDITIONER_INCOMPLETE_CHOLESKY &&
+           SolveIterative(ws.cgIncompleteCholesky, ws.cgIncompleteCholeskyAnalysis, ws, options, K, stats)) {
+            return true;
+        }
+        if(options.preconditioner == UV_MAP_PRECONDITIONER_MULTIGRID &&
+           SolveIterative(ws.cgMultigrid, ws.cgMultigridAnalysis, ws, options, K, stats)) {
+            return true;
+        }
+        if(!SolveIterative(ws.cgDiagonal, ws.cgDiagonalAnalysis, ws, options, K, stats)) {
+            return false;
+        }
+        return true;
+    }
+
+    if(options.solver == UV_MAP_SOLVER_CHOLESKY && options.backend &&
+       SolveBackend(ws, options, K, stats)) {
+        return true;
+    }
+
+    // if it fails, SolveDirect falls back to LU.
+    if(options.solver == UV_MAP_SOLVER_DOMAIN_DECOMPOSITION &&
+       SolveDomainDecomposition(ws, options, K, stats)) {
+        return true;
+    }
+
+    // the solvers of the ordering. Without METIS, its solvers are never even instantiated.
+    switch(options.ordering) {
+    case UV_MAP_ORDERING_AMD:
+        return SolveDirect(ws.amd, ws.amd, ws, options, K, stats);
+    case UV_MAP_ORDERING_COLAMD:
+        return SolveDirect(ws.colamd, ws.colamd, ws, options, K, stats);
+#ifdef AUTO_UV_USE_METIS
+    case UV_MAP_ORDERING_METIS:
+        return SolveDirect(ws.metis, ws.metis, ws, options, K, stats);
+#else
+    case UV_MAP_ORDERING_METIS:
+#endif
+    case UV_MAP_ORDERING_MESH_NESTED_DISSECTION:
+        return SolveDirect(ws.nestedDissection, ws.nestedDissection, ws, options, K, stats);
+    default:
+        return SolveDirect(ws.amd, ws.colamd, ws, options, K, stats);
+    }
+}
+
+// Finds the vertices of the half edge mesh in the workspace that are fixed, and numbers
+// the rest, the unknowns. Only depends on the connectivity, and on which boundary loop is
+// the longest. Returns the number of unknowns, or -1 if the mesh has no boundary.
+static int FindUnknowns(UvMapWorkspace::Buffers& ws) {
+    const IndexedHalfEdgeMesh& hem = ws.mesh;
 
     // N is number of variables in the linear system. We want uv coordinates for every vertex
     // so one variable for every vertex.
     const int N = hem.NumVertices();
 
     //
-    // Let us first find the boundary. So let us find the first boundary edge.
+    // Let us first find the boundary. The mesh already knows all its boundary
+    // loops. If there are several (that is, the mesh has holes), we pick the
+    // longest one as the outer boundary.
     //
-    HalfEdgeIter firstBoundary = hem.EndHalfEdges();
-    HalfEdgeIter currentBoundary = hem.EndHalfEdges();
-    for(HalfEdgeIter heit = hem.BeginHalfEdges(); heit != hem.EndHalfEdges(); heit++) {
-        if(hem.IsBoundary(heit)) {
-            firstBoundary = heit;
-            break;
-        }
+    if(hem.NumBoundaryLoops() == 0) {
+        return -1;
     }
 
-    if(firstBoundary == hem.EndHalfEdges()) {
-        printf("ERROR: found no boundary in mesh\n");
+    HalfEdgeIndex firstBoundary = INVALID_INDEX;
+    HalfEdgeIndex currentBoundary = INVALID_INDEX;
+    float longestLoop = -1.0f;
+    for(uint32_t loop = 0; loop < hem.NumBoundaryLoops(); loop++) {
+        float loopLength = 0.0f;
+
+        currentBoundary = hem.BoundaryLoopHalfEdge(loop);
+        for(uint32_t i = 0; i < hem.BoundaryLoopLength(loop); i++) {
+            loopLength += hem.GetLength(currentBoundary);
+            currentBoundary = hem.GetNextBoundary(currentBoundary);
+        }
+
+        if(loopLength > longestLoop) {
+            longestLoop = loopLength;
+            firstBoundary = hem.BoundaryLoopHalfEdge(loop);
+        }
     }
 
     //
     // find the rest of the boundary by iterating over the boundary.
-    // also, keep track of the cumulative edge length over the boundary.
     //
-    vector<HalfEdgeIter> boundaryEdges;
-    vector<VertexIter> boundaryVertices;
-    set<int> boundarySet;
-    vector<float> edgeLengths; // cumulative edge lengths
-    float totalEdgeLength = 0;
+    vector<VertexIndex>& boundaryVertices = ws.boundaryVertices;
+    vector<char>& isFixed = ws.isFixed;
 
-    HalfEdgeIter previousBoundary = firstBoundary;
-    currentBoundary = firstBoundary;
-    do {
-        boundaryEdges.push_back(currentBoundary);
-        boundaryVertices.push_back(currentBoundary->vertex);
-        boundarySet.insert(currentBoundary->vertex->id);
+    const uint32_t boundaryLength = hem.BoundaryLoopLength(hem.BoundaryLoop(firstBoundary));
+    ResizeBuffer(boundaryVertices, boundaryLength, ws.numAllocations);
+    AssignBuffer(isFixed, N, (char)0, ws.numAllocations);
 
-        // cumulative edge length of 'currentBoundary->vertex'
-        edgeLengths.push_back(totalEdgeLength);
+    currentBoundary = firstBoundary;
+    for(uint32_t i = 0; i < boundaryLength; i++) {
+        boundaryVertices[i] = hem.Vertex(currentBoundary);
+        isFixed[hem.Vertex(currentBoundary)] = 1;
         currentBoundary = hem.GetNextBoundary(currentBoundary);
+    }
+
+    // vertices that are not part of any face are not connected to anything,
+    // so we simply fix them at the origin, just like we fix the boundary.
+    for(VertexIndex vit = 0; vit < hem.NumVertices(); vit++) {
+        if(hem.VertexHalfEdge(vit) == INVALID_INDEX) {
+            isFixed[vit] = 1;
+        }
+    }
 
+    //
+    // Only the remaining vertices are unknowns in the linear system,
+    // so we number them from 0 to M-1.
+    //
+    vector<uint32_t>& unknownIndex = ws.unknownIndex;
+    ResizeBuffer(unknownIndex, N, ws.numAllocations);
+    int M = 0;
+    for(int i = 0; i < N; i++) {
+        unknownIndex[i] = isFixed[i] ? INVALID_INDEX : M++;
+    }
+    return M;
+}
+
+//
+// The uv coordinates of the fixed vertices are already known, so we put
+// them right into x and y. We project the boundary vertices onto a circle,
+// spaced by the lengths of the boundary edges in the given positions,
+// so for boundary vertices we have:
+// (x[i], y[i]) = (cos(theta),sin(theta))
+//
+template<typename Positions>
+static void MapBoundary(UvMapWorkspace::Buffers& ws, const Positions& position) {
+    const int N = ws.mesh.NumVertices();
+    const vector<VertexIndex>& boundaryVertices = ws.boundaryVertices;
+    const uint32_t boundaryLength = boundaryVertices.size();
+
+    // keep track of the cumulative edge length over the boundary.
+    vector<float>& edgeLengths = ws.edgeLengths;
+    ResizeBuffer(edgeLengths, boundaryLength, ws.numAllocations);
+    float totalEdgeLength = 0;
+    for(uint32_t i = 0; i < boundaryLength; i++) {
+        // cumulative edge length of boundary vertex i.
+        edgeLengths[i] = totalEdgeLength;
         totalEdgeLength += vec3::distance(
-            previousBoundary->vertex->p, currentBoundary->vertex->p
+            position(boundaryVertices[i]), position(boundaryVertices[(i + 1) % boundaryLength])
             );
-        previousBoundary = currentBoundary;
-    } while(currentBoundary != firstBoundary);
-
-    // Now let us formulate the linear system. We have two systems:
-    // W * x = bx
-    // W * y = by
-    // one system for each of the two uv-coordinates.
-    Eigen::VectorXd bx(N);
-    Eigen::VectorXd by(N);
-
-    // Here's bx and by:
-    // for non-boundary vertices, we have
-    // (bx[i], by[i]) = (0,0)
-    // for boundary vertices, we project them onto a circle.
-    // so for boundary vertices we have:
-    // (bx[i], by[i]) = (cos(theta),sin(theta))
+    }
+
+    ResizeBuffer(ws.x, N, ws.numAllocations);
+    ResizeBuffer(ws.y, N, ws.numAllocations);
+    vector<double>& x = ws.x;
+    vector<double>& y = ws.y;
+
     for(int i = 0; i < N; i++) {
-        bx[i] = 0.0f;
-        by[i] = 0.0f;
+        x[i] = 0.0f;
+        y[i] = 0.0f;
     }
     for(int i = 0; i < boundaryVertices.size(); i++) {
-        VertexIter vit = boundaryVertices[i];
+        VertexIndex vit = boundaryVertices[i];
         double theta = (edgeLengths[i]/totalEdgeLength)*2.0f*M_PI;
-        bx[vit->id] = cos(theta);
-        by[vit->id] = sin(theta);
+        x[vit] = cos(theta);
+        y[vit] = sin(theta);
+    }
+}
+
+// Sets the solution the iterative solvers start from to initialUvs, or to zero.
+static void SetInitialGuess(UvMapWorkspace::Buffers& ws, int M, const float* initialUvs) {
+    AssignBuffer(ws.solution, 2 * M, 0.0, ws.numAllocations);
+    if(initialUvs) {
+        for(int i = 0; i < (int)ws.mesh.NumVertices(); i++) {
+            if(ws.unknownIndex[i] != INVALID_INDEX) {
+                ws.solution[ws.unknownIndex[i]] = initialUvs[2 * i + 0];
+                ws.solution[M + ws.unknownIndex[i]] = initialUvs[2 * i + 1];
+            }
+        }
+    }
+}
+
+// Solves the assembled system, and puts the uvs of the unknowns into x and y.
+static UvMapStatus SolveUnknowns(UvMapWorkspace::Buffers& ws, const UvMapOptions& options, int M, UvMapStats& stats) {
+    // now finally solve! The direct solvers always converge, and the
+    // iterative solvers clear this if they do not.
+    stats.converged = true;
+    if(!EnterStage(ws, options, UV_MAP_STAGE_FACTORIZE)) {
+        return UV_MAP_CANCELLED;
+    }
+    if(M > 0) {
+        if(!SolveSystem(ws, options, 2, stats)) {
+            return UV_MAP_ERROR_SOLVER_FAILED;
+        }
+    } else if(!EnterStage(ws, options, UV_MAP_STAGE_SOLVE)) {
+        return UV_MAP_CANCELLED;
+    }
+
+    // the solvers skip the solve if the call was cancelled while they factorized.
+    if(Cancelled(ws, options)) {
+        return UV_MAP_CANCELLED;
+    }
+
+    const vector<uint32_t>& unknownIndex = ws.unknownIndex;
+    for(int i = 0; i < (int)ws.mesh.NumVertices(); i++) {
+        if(unknownIndex[i] != INVALID_INDEX) {
+            ws.x[i] = ws.solution[unknownIndex[i]];
+            ws.y[i] = ws.solution[M + unknownIndex[i]];
+        }
     }
+    return UV_MAP_SUCCESS;
+}
+
+/*
+
+           /\
+         / u \
+     b1/      \a1
+     /     c   \
+   / -----------\
+   \            /
+    \         /
+   a2\      /b2
+      \ v /
+       \/
+
+Compute the harmonic weight of every edge.
+
+It is computed by the formula
+
+(cot(u) + cot(v)) / 2
 
-    typedef Eigen::Triplet<double> Triplet;
+see the beautiful ASCII art above for an illustration.
+
+u and v are angles of the two faces of the edge, and every angle of every face is
+used by exactly one edge. So the cotangents are first computed face by face, with
+FaceCotangents, and then every edge gathers the two cotangents of its half edges.
+
+The position of vertex v is (px[stride*v], py[stride*v], pz[stride*v]), so that the
+same connectivity can be used with several sets of positions. cotangents needs room
+for the three cotangents of every face.
+*/
+static void ComputeEdgeWeights(
+    const IndexedHalfEdgeMesh& hem,
+    const float* px, const float* py, const float* pz, int stride,
+    float* cotangents, float* weights, int numThreads) {
+
+    // the faces are split into blocks of FACE_BLOCK_SIZE, so that whether a face is computed
+    // by the SIMD or the scalar code does not depend on the number of threads.
+    const size_t FACE_BLOCK_SIZE = 8;
+    const size_t numFaces = hem.NumFaces();
+    const size_t numBlocks = (numFaces + FACE_BLOCK_SIZE - 1) / FACE_BLOCK_SIZE;
+    ParallelFor(0, numBlocks, numThreads, MIN_CHUNK_SIZE / FACE_BLOCK_SIZE, [&](size_t begin, size_t end, int) {
+        FaceCotangents(px, py, pz, stride, hem.FaceVertices(),
+            begin * FACE_BLOCK_SIZE, std::min(end * FACE_BLOCK_SIZE, numFaces), cotangents);
+    });
+
+    ParallelFor(0, hem.NumEdges(), numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(EdgeIndex eit = begin; eit < end; eit++) {
+            // The boundary vertices are fixed(they are projected on a circle),
+            // so we do not need to compute any weights of the boundary edges.
+            // So the boundary edges contribute very little to the final linear system.
+            HalfEdgeIndex he = hem.EdgeHalfEdge(eit);
+            HalfEdgeIndex twin = hem.Twin(he);
+            if(twin == INVALID_INDEX) {
+                weights[eit] = 0.0f;
+                continue;
+            }
+
+            float weight = (cotangents[he] + cotangents[twin]) * 0.5f;
+
+            // if we instead set the weight to one, then we get uniform weights. But that sucks, though.
+//            weight = 1.0;
+
+            weights[eit] = weight;
+        }
+    });
+}
 
-    // W is very sparse, so much can be saved by using a sparse matrix.
-    typedef Eigen::SparseMatrix<double> SparseMatrix;
-    SparseMatrix W(N, N);
+//
+// Now let us formulate the linear system. We have two systems:
+// W * u = bx
+// W * v = by
+// one system for each of the two uv-coordinates, where u and v are the
+// x and y of the unknown vertices.
+//
+// For every unknown vertex i, the harmonic map satisfies
+// sum_j w_ij * (x[j] - x[i]) = 0
+// where the sum is over all the neighbours j of i, and w_ij is the harmonic weight
+// of the edge between them. Moving all the known x[j] over to the right hand side gives
+// (sum_j w_ij) * x[i] - (sum_{unknown j} w_ij * x[j]) = sum_{fixed j} w_ij * x[j]
+//
+// So W is symmetric, and it is also positive definite, because every unknown
+// vertex is connected to the fixed boundary. And that means that we
+// can solve it with a sparse Cholesky factorization.
+//
+// Which elements of W are non-zero only depends on the connectivity: column i has the
+// diagonal, and an element for every unknown neighbour of vertex i across an inner edge.
+// So W is written directly in compressed form, column by column from the edges of every
+// vertex, with all its values set to zero, along with where in W.valuePtr() every edge
+// goes. FillSystem then fills in the values. W is symmetric, so its compressed columns
+// are also its compressed rows.
+//
+static void BuildSystemPattern(UvMapWorkspace::Buffers& ws, int M, int numThreads) {
+    const IndexedHalfEdgeMesh& hem = ws.mesh;
+    const vector<uint32_t>& unknownIndex = ws.unknownIndex;
+    const size_t numVertices = hem.NumVertices();
 
-    vector<Triplet> triplets;
-    vector<double> diag; // diagonal values in W.
-    diag.resize(N, 0);
+    // the unknown neighbour of vertex i0 across the edge, or INVALID_INDEX if the
+    // edge does not go into W.
+    #define UNKNOWN_NEIGHBOUR(i0, e) ( \
+        hem.IsBoundaryEdge(e) ? INVALID_INDEX : \
+        unknownIndex[hem.Vertex(hem.EdgeHalfEdge(e)) == (i0) ? hem.Vertex(hem.Twin(hem.EdgeHalfEdge(e))) : hem.Vertex(hem.EdgeHalfEdge(e))])
 
-    for(EdgeIter eit = hem.BeginEdges(); eit != hem.EndEdges(); eit++) {
-        // The boundary vertices are fixed(they are projected on a circle),
-        // so we do not need to compute any weights of the boundary edges.
-        // So the boundary edges contribute very little to the final linear system.
-        if(hem.IsBoundary(eit)) {
-            continue;
+    // the number of elements in every column, from the valences of the vertices.
+    // An edge from a vertex to itself only adds to the diagonal.
+    SparseMatrix& W = ws.W;
+    W.resize(M, M);
+    int* outer = W.outerIndexPtr();
+    outer[0] = 0;
+    ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(VertexIndex i0 = begin; i0 < end; i0++) {
+            const uint32_t u0 = unknownIndex[i0];
+            if(u0 == INVALID_INDEX) {
+                continue;
+            }
+            int count = 1;
+            for(const EdgeIndex* e = hem.VertexEdgesBegin(i0); e != hem.VertexEdgesEnd(i0); e++) {
+                const uint32_t u1 = UNKNOWN_NEIGHBOUR(i0, *e);
+                if(u1 != INVALID_INDEX && u1 != u0) {
+                    count++;
+                }
+            }
+            outer[u0 + 1] = count;
         }
+    });
+    for(int i = 0; i < M; i++) {
+        outer[i + 1] += outer[i];
+    }
 
-        VertexIter v0 = eit->halfEdge->vertex;
-        VertexIter v1 = eit->halfEdge->twin->vertex;
+    W.resizeNonZeros(outer[M]);
+    int* inner = W.innerIndexPtr();
+    double* values = W.valuePtr();
 
-        int i0 = v0->id;
-        int i1 = v1->id;
+    // element (u0, u1) of the edge, and then (u1, u0). -1 if not in W.
+    vector<int>& edgeSlots = ws.edgeSlots;
+    AssignBuffer(edgeSlots, 2 * hem.NumEdges(), -1, ws.numAllocations);
+    vector<int>& diagSlots = ws.diagSlots;
+    ResizeBuffer(diagSlots, M, ws.numAllocations);
 
-        float weight = HarmonicWeight(eit);
+    // every column is only written by the thread of its vertex, and so is the slot
+    // of every element in it.
+    ParallelFor(0, numVertices, numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(VertexIndex i0 = begin; i0 < end; i0++) {
+            const uint32_t u0 = unknownIndex[i0];
+            if(u0 == INVALID_INDEX) {
+                continue;
+            }
 
-        // if we instead set the weight to one, then we get uniform weights. But that sucks, though.
-//        weight = 1.0;
+            // the rows of the column, sorted by insertion. Columns are short.
+            int* rows = inner + outer[u0];
+            int count = 0;
+            rows[count++] = u0;
+            for(const EdgeIndex* e = hem.VertexEdgesBegin(i0); e != hem.VertexEdgesEnd(i0); e++) {
+                const uint32_t u1 = UNKNOWN_NEIGHBOUR(i0, *e);
+                if(u1 == INVALID_INDEX || u1 == u0) {
+                    continue;
+                }
+                int j = count++;
+                for(; j > 0 && rows[j - 1] > (int)u1; j--) {
+                    rows[j] = rows[j - 1];
+                }
+                rows[j] = u1;
+            }
+            for(int j = 0; j < count; j++) {
+                values[outer[u0] + j] = 0.0;
+            }
 
-        // We set the weights for non-boundary edges.
-        // Note that the conditionals are very important!
-        // If i is some boundary vertex, then we need to make sure
-        // that in row i, (i,i) is one, and all other elements are zero.
-        // Because in the linear system we should have
-        // 1.0 * x[i] = bx[i]
-        // (so also below for more explanations)
-        if(boundarySet.count(i0) == 0) {
-            triplets.push_back(Triplet(i0, i1, weight));
+            #define FIND_SLOT(row) (int)(std::lower_bound(rows, rows + count, (int)(row)) - inner)
+            diagSlots[u0] = FIND_SLOT(u0);
+            for(const EdgeIndex* e = hem.VertexEdgesBegin(i0); e != hem.VertexEdgesEnd(i0); e++) {
+                const uint32_t u1 = UNKNOWN_NEIGHBOUR(i0, *e);
+                if(u1 == INVALID_INDEX || u1 == u0) {
+                    continue;
+                }
+                // this column holds the element (u1, u0) of the edge, which is the first
+                // slot of the edge if i0 is the vertex of its other half edge.
+                const bool isFirst = hem.Vertex(hem.EdgeHalfEdge(*e)) != i0;
+                edgeSlots[2 * (*e) + (isFirst ? 0 : 1)] = FIND_SLOT(u1);
+            }
+            #undef FIND_SLOT
         }
-        if(boundarySet.count(i1) == 0) {
-            triplets.push_back(Triplet(i1, i0, weight));
+    });
+
+    #undef UNKNOWN_NEIGHBOUR
+
+    ws.pattern = SparsityPatternHash(W);
+}
+
+//
+// Fills in the values of W and of the right hand sides, from the harmonic weights of
+// the edges and the uvs of the fixed vertices in x and y.
+//
+// Every edge adds to the rows of its unknown vertices. Instead of having every edge
+// add to two rows, which would need the threads to synchronize, every row gathers the
+// weights of its edges, from the first edge to the last. So every sum is added up in
+// the same order, however many threads there are, and the result is always the same.
+//
+// With the matrix-free solver, W is never built. Then only its diagonal is filled in, and
+// the solver computes the rest of W from the weights.
+//
+static void FillSystem(UvMapWorkspace::Buffers& ws, int M, const float* weights, bool matrixFree, int numThreads) {
+    const IndexedHalfEdgeMesh& hem = ws.mesh;
+    const vector<uint32_t>& unknownIndex = ws.unknownIndex;
+    const vector<double>& x = ws.x;
+    const vector<double>& y = ws.y;
+    double* values = ws.W.valuePtr();
+    double* diagonal = ws.matrixFree.Diagonal();
+
+    // bx and by are the two columns of the right hand side, so that both
+    // systems can be solved together.
+    ResizeBuffer(ws.rhs, 2 * M, ws.numAllocations);
+    double* bx = ws.rhs.data();
+    double* by = ws.rhs.data() + M;
+
+    // if both vertices are unknown, the weight goes into W.
+    if(matrixFree) {
+        ws.matrixFree.SetWeights(weights);
+    } else {
+        ParallelFor(0, hem.NumEdges(), numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+            for(EdgeIndex eit = begin; eit < end; eit++) {
+                if(ws.edgeSlots[2 * eit + 0] != -1) {
+                    values[ws.edgeSlots[2 * eit + 0]] = -weights[eit];
+                    values[ws.edgeSlots[2 * eit + 1]] = -weights[eit];
+                }
+            }
+        });
+    }
+
+    // and every edge adds to the diagonal, or to the right hand side if
+    // the other vertex is fixed.
+    ParallelFor(0, hem.NumVertices(), numThreads, MIN_CHUNK_SIZE, [&](size_t begin, size_t end, int) {
+        for(VertexIndex i0 = begin; i0 < end; i0++) {
+            const uint32_t u0 = unknownIndex[i0];
+            if(u0 == INVALID_INDEX) {
+                continue;
+            }
+
+            double diag = 0.0;
+            double sumX = 0.0;
+            double sumY = 0.0;
+            for(const EdgeIndex* e = hem.VertexEdgesBegin(i0); e != hem.VertexEdgesEnd(i0); e++) {
+                if(hem.IsBoundaryEdge(*e)) {
+                    continue;
+                }
+
+                HalfEdgeIndex he = hem.EdgeHalfEdge(*e);
+                VertexIndex i1 = hem.Vertex(he) == i0 ? hem.Vertex(hem.Next(he)) : hem.Vertex(he);
+                float weight = weights[*e];
+
+                diag += weight;
+                if(unknownIndex[i1] == INVALID_INDEX) {
+                    sumX += weight * x[i1];
+                    sumY += weight * y[i1];
+                }
+            }
+
+            if(matrixFree) {
+                diagonal[u0] = diag;
+            } else {
+                values[ws.diagSlots[u0]] = diag;
+            }
+            bx[u0] = sumX;
+            by[u0] = sumY;
         }
+    });
+}
+
+// Maps the simplified mesh of UvMapOptions::coarseVertices, with the uvs of the fixed vertices
+// that are already in x and y, and interpolates its uvs to all the vertices, into previewUvs.
+static UvMapStatus MapCoarseMesh(UvMapWorkspace::Buffers& ws, const UvMapOptions& options, UvMapStats& stats) {
+    Clock::time_point start = Clock::now();
+    const int numThreads = NumThreads(options);
+    MeshSimplifier& simplifier = ws.simplifier;
+    simplifier.Simplify(ws.mesh, options.coarseVertices);
+
+    if(!ws.coarse) {
+        ws.coarse.reset(new UvMapWorkspace());
+        ws.numAllocations++;
+    }
+    UvMapWorkspace::Buffers& coarse = ws.coarse->GetBuffers();
+    const IndexedHalfEdgeMesh& hem = coarse.mesh;
+    if(!coarse.mesh.Build(simplifier.Positions(), simplifier.NumVertices(), simplifier.Indices(), simplifier.NumFaces(), numThreads)) {
+        return UV_MAP_ERROR_INVALID_MESH;
+    }
+
+    // every fixed vertex is kept, so the fixed vertices and their uvs are simply copied, rather
+    // than found again, which could pick another boundary loop, or start it somewhere else.
+    const int numCoarse = simplifier.NumVertices();
+    ResizeBuffer(coarse.unknownIndex, numCoarse, coarse.numAllocations);
+    ResizeBuffer(coarse.x, numCoarse, coarse.numAllocations);
+    ResizeBuffer(coarse.y, numCoarse, coarse.numAllocations);
+    int M = 0;
+    for(int i = 0; i < numCoarse; i++) {
+        const uint32_t v = simplifier.Vertex(i);
+        coarse.unknownIndex[i] = ws.isFixed[v] ? INVALID_INDEX : M++;
+        coarse.x[i] = ws.x[v];
+        coarse.y[i] = ws.y[v];
+    }
+
+    BuildSystemPattern(coarse, M, numThreads);
+    ResizeBuffer(coarse.faceCotangents, hem.NumHalfEdges(), coarse.numAllocations);
+    ResizeBuffer(coarse.edgeWeights, hem.NumEdges(), coarse.numAllocations);
+    ComputeEdgeWeights(hem, hem.PositionsX(), hem.PositionsY(), hem.PositionsZ(), 1,
+        coarse.faceCotangents.data(), coarse.edgeWeights.data(), numThreads);
+    FillSystem(coarse, M, coarse.edgeWeights.data(), false, numThreads);
+
+    // the simplified mesh is small, so it is solved directly, without reporting its stages.
+    UvMapOptions coarseOptions;
+    coarseOptions.numThreads = options.numThreads;
+    coarseOptions.cancel = options.cancel;
+    coarse.jobCancel = ws.jobCancel;
+    UvMapStats coarseStats;
+    SetInitialGuess(coarse, M, NULL);
+    const UvMapStatus status = SolveUnknowns(coarse, coarseOptions, M, coarseStats);
+    if(status != UV_MAP_SUCCESS) {
+        return status;
+    }
+
+    ResizeBuffer(ws.coarseUvs, 2 * numCoarse, ws.numAllocations);
+    for(int i = 0; i < numCoarse; i++) {
+        ws.coarseUvs[2 * i + 0] = coarse.x[i];
+        ws.coarseUvs[2 * i + 1] = coarse.y[i];
+    }
+    ResizeBuffer(ws.previewUvs, 2 * ws.mesh.NumVertices(), ws.numAllocations);
+    simplifier.Prolong(ws.coarseUvs.data(), ws.previewUvs.data());
+
+    stats.coarseVertices = numCoarse;
+    stats.coarseMilliseconds = MillisecondsSince(start);
+    return UV_MAP_SUCCESS;
+}
+
+// UV maps the half edge mesh in the workspace. outUvs receives the uv coordinates of
+// all the vertices of the mesh, two floats for each vertex.
+static UvMapStatus UvMapMesh(
+    UvMapWorkspace::Buffers& ws,
+    const UvMapOptions& options,
+    float* outUvs,
+    std::vector<float>* outUvEdges,
+    UvMapStats& stats
+    ) {
 
-        diag[i0] -= weight;
-        diag[i1] -= weight;
-    }
-
-    for (int i = 0; i < diag.size(); i++) {
-        if(boundarySet.count(i) > 0) {
-            // for boundary vertices, diagonal is one.
-            // The result of this will be that the i:th equation(that is, row i) in the linear system becomes
-            // 1.0 * x[i] = bx[i]
-            // which is correct. Because the boundary vertices are fixed,
-            // and thus we already know the value of x[i].
-            triplets.push_back(Triplet(i, i, 1.0));
-        } else {
-            // for non-boundary vertices, the diagonal is the NEGATIVE sum
-            // of all non-diagonal elements in row i.
-            triplets.push_back(Triplet(i, i, diag[i]));
+    const IndexedHalfEdgeMesh& hem = ws.mesh;
+    const int N = hem.NumVertices();
+    const int numThreads = NumThreads(options);
+
+    // To now find the uv coordinates, we will create a system of
+    // linear equations. The system is formulated with matrices and vectors,
+    // and then we solve it with Eigen.
+    if(!EnterStage(ws, options, UV_MAP_STAGE_BOUNDARY)) {
+        return UV_MAP_CANCELLED;
+    }
+    const int M = FindUnknowns(ws);
+    if(M < 0) {
+        return UV_MAP_ERROR_NO_BOUNDARY;
+    }
+    MapBoundary(ws, MeshPositions(hem));
+
+    // the uvs of a simplified mesh are a preview, and the start of the iterations. If the
+    // simplified mesh can not be mapped, the mesh is simply mapped without them.
+    const float* initialUvs = options.initialUvs;
+    if(options.coarseVertices > 0 && N > options.coarseVertices && M > 0) {
+        if(!EnterStage(ws, options, UV_MAP_STAGE_PREVIEW)) {
+            return UV_MAP_CANCELLED;
+        }
+        const UvMapStatus status = MapCoarseMesh(ws, options, stats);
+        if(status == UV_MAP_CANCELLED) {
+            return status;
+        }
+        if(status == UV_MAP_SUCCESS) {
+            if(options.preview) {
+                options.preview(ws.previewUvs.data(), options.previewUserData);
+            }
+            initialUvs = ws.previewUvs.data();
         }
     }
 
-    // construct sparse matrix.
-    W.setFromTriplets(triplets.begin(), triplets.end());
+    if(!EnterStage(ws, options, UV_MAP_STAGE_ASSEMBLE)) {
+        return UV_MAP_CANCELLED;
+    }
+    const bool matrixFree = options.solver == UV_MAP_SOLVER_MATRIX_FREE_CONJUGATE_GRADIENT;
+    if(matrixFree) {
+        ws.matrixFree.Setup(hem, ws.unknownIndex.data(), M, numThreads);
+    } else {
+        BuildSystemPattern(ws, M, numThreads);
+    }
+
+    // the harmonic weights are all that depends on the positions of the inner vertices.
+    ResizeBuffer(ws.faceCotangents, hem.NumHalfEdges(), ws.numAllocations);
+    ResizeBuffer(ws.edgeWeights, hem.NumEdges(), ws.numAllocations);
+    ComputeEdgeWeights(hem, hem.PositionsX(), hem.PositionsY(), hem.PositionsZ(), 1,
+        ws.faceCotangents.data(), ws.edgeWeights.data(), numThreads);
+    FillSystem(ws, M, ws.edgeWeights.data(), matrixFree, numThreads);
 
-    Eigen::SparseLU<SparseMatrix > solver;
-    solver.compute(W);
-    if(solver.info()!=Eigen::Success) {
-        printf("ERROR: found no decomposition of sparse matrix\n");
-        exit(1);
+    // the iterative solvers start from the initial guess, if there is one.
+    SetInitialGuess(ws, M, initialUvs);
+    const UvMapStatus status = SolveUnknowns(ws, options, M, stats);
+    if(status != UV_MAP_SUCCESS) {
+        return status;
     }
 
-    // now finally solve!
-    Eigen::VectorXd x(N);
-    Eigen::VectorXd y(N);
-    x = solver.solve(bx);
-    y = solver.solve(by);
+    const vector<double>& x = ws.x;
+    const vector<double>& y = ws.y;
 
     // output uvs.
     for(int i = 0; i < N; i++) {
-        outUvs.push_back(x[i]);
-        outUvs.push_back(y[i]);
+        outUvs[2 * i + 0] = x[i];
+        outUvs[2 * i + 1] = y[i];
     }
 
     // recover all the edges of the flattened, uv-mapped mesh(useful for visualization):
     if(outUvEdges) {
-        for(EdgeIter eit = hem.BeginEdges(); eit != hem.EndEdges(); eit++) {
-            int i0 = eit->halfEdge->vertex->id;
-            int i1 = eit->halfEdge->next->vertex->id;
+        for(EdgeIndex eit = 0; eit < hem.NumEdges(); eit++) {
+            int i0 = hem.Vertex(hem.EdgeHalfEdge(eit));
+            int i1 = hem.Vertex(hem.Next(hem.EdgeHalfEdge(eit)));
 
-            outUvEdges->push_back(outUvs[i0 * 2 + 0]);
-            outUvEdges->push_back(outUvs[i0 * 2 + 1]);
+            outUvEdges->push_back(x[i0]);
+            outUvEdges->push_back(y[i0]);
 
-            outUvEdges->push_back(outUvs[i1 * 2 + 0]);
-            outUvEdges->push_back(outUvs[i1 * 2 + 1]);
+            outUvEdges->push_back(x[i1]);
+            outUvEdges->push_back(y[i1]);
 
 
         }
     }
+    return UV_MAP_SUCCESS;
+}
+
+// Starts the time budget of the call, if it has one, and returns the options to map with.
+// Those have the matrix-free solver, the only one that neither factorizes nor sets up a
+// preconditioner, which could take far longer than the budget, and that stops at the deadline.
+static UvMapOptions StartTimeBudget(UvMapWorkspace::Buffers& ws, const UvMapOptions& options) {
+    UvMapOptions budgeted = options;
+    ws.deadline = Clock::time_point::max();
+    if(options.timeBudgetMilliseconds > 0.0) {
+        ws.deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::milli>(options.timeBudgetMilliseconds));
+        budgeted.solver = UV_MAP_SOLVER_MATRIX_FREE_CONJUGATE_GRADIENT;
+    }
+    return budgeted;
+}
+
+bool uvMapHasBackend(const char* name) {
+    return strcmp(name, "eigen") == 0 || CreateSparseDirectSolver(name);
+}
+
+const char* uvMapStatusMessage(UvMapStatus status) {
+    switch(status) {
+    case UV_MAP_SUCCESS:
+        return "the mesh was mapped";
+    case UV_MAP_ERROR_INVALID_MESH:
+        return "the faces do not make a valid mesh";
+    case UV_MAP_ERROR_NO_BOUNDARY:
+        return "found no boundary in the mesh";
+    case UV_MAP_ERROR_SOLVER_FAILED:
+        return "found no solver for the linear system of the mesh";
+    case UV_MAP_CANCELLED:
+        return "the call was cancelled";
+    default:
+        return "unknown status";
+    }
+}
+
+UvMapStatus uvMap(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    std::vector<float>* outUvEdges
+    ) {
+
+    UvMapWorkspace workspace;
+    return uvMap(positions, numVertices, indices, numFaces, outUvs, outUvEdges, workspace, UvMapOptions());
+}
+
+UvMapStatus uvMap(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    std::vector<float>* outUvEdges,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options,
+    UvMapStats* stats
+    ) {
+
+    return uvMapCancellable(positions, numVertices, indices, numFaces, outUvs, outUvEdges, workspace, options, stats, NULL);
+}
+
+UvMapStatus uvMapCancellable(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    std::vector<float>* outUvEdges,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options,
+    UvMapStats* stats,
+    const std::atomic<bool>* jobCancel
+    ) {
+
+    UvMapWorkspace::Buffers& ws = workspace.GetBuffers();
+    ws.jobCancel = jobCancel;
+    const UvMapOptions budgeted = StartTimeBudget(ws, options);
+
+    // instead of a polygon soup, we use a half edge mesh.
+    if(!EnterStage(ws, options, UV_MAP_STAGE_BUILD)) {
+        return UV_MAP_CANCELLED;
+    }
+    if(!ws.mesh.Build(positions, numVertices, indices, numFaces, NumThreads(options))) {
+        return UV_MAP_ERROR_INVALID_MESH;
+    }
+
+    UvMapStats localStats;
+    const UvMapStatus status = UvMapMesh(ws, budgeted, outUvs, outUvEdges, localStats);
+    if(stats) {
+        *stats = localStats;
+    }
+    return status;
+}
+
+UvMapStatus uvMapFixedVertices(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options,
+    int& numUnknowns,
+    std::vector<char>& isFixed,
+    std::vector<double>& x,
+    std::vector<double>& y
+    ) {
 
-    vVertices.clear();
-    vFaces.clear();
-    hem.ToMesh(vVertices, vFaces);
+    UvMapWorkspace::Buffers& ws = workspace.GetBuffers();
+    if(!ws.mesh.Build(positions, numVertices, indices, numFaces, NumThreads(options))) {
+        return UV_MAP_ERROR_INVALID_MESH;
+    }
+    numUnknowns = FindUnknowns(ws);
+    if(numUnknowns < 0) {
+        return UV_MAP_ERROR_NO_BOUNDARY;
+    }
+    MapBoundary(ws, MeshPositions(ws.mesh));
+
+    isFixed = ws.isFixed;
+    x = ws.x;
+    y = ws.y;
+    return UV_MAP_SUCCESS;
+}
 
+UvMapStatus uvMapBatch(
+    const float* const* positions,
+    size_t numFrames,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
 
+    float* const* outUvs,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options,
+    UvMapStats* stats
+    ) {
+
+    if(numFrames == 0) {
+        return UV_MAP_SUCCESS;
+    }
+
+    UvMapWorkspace::Buffers& ws = workspace.GetBuffers();
+    const IndexedHalfEdgeMesh& hem = ws.mesh;
+    const int numThreads = NumThreads(options);
+    ws.jobCancel = NULL;
+
+    // the time budget is for all the frames together.
+    const UvMapOptions budgeted = StartTimeBudget(ws, options);
+
+    // everything that only depends on the connectivity is done once, for the first frame.
+    if(!EnterStage(ws, options, UV_MAP_STAGE_BUILD)) {
+        return UV_MAP_CANCELLED;
+    }
+    if(!ws.mesh.Build(positions[0], numVertices, indices, numFaces, numThreads)) {
+        return UV_MAP_ERROR_INVALID_MESH;
+    }
+    if(!EnterStage(ws, options, UV_MAP_STAGE_BOUNDARY)) {
+        return UV_MAP_CANCELLED;
+    }
+    const int M = FindUnknowns(ws);
+    if(M < 0) {
+        return UV_MAP_ERROR_NO_BOUNDARY;
+    }
+    const bool matrixFree = budgeted.solver == UV_MAP_SOLVER_MATRIX_FREE_CONJUGATE_GRADIENT;
+    if(matrixFree) {
+        ws.matrixFree.Setup(hem, ws.unknownIndex.data(), M, numThreads);
+    } else {
+        BuildSystemPattern(ws, M, numThreads);
+    }
+    SetInitialGuess(ws, M, options.initialUvs);
+
+    // The weights of a group of frames are computed in parallel, one frame per thread,
+    // and then the frames are solved one by one. Only a group is kept at a time, to
+    // bound the memory.
+    const size_t numEdges = hem.NumEdges();
+    const size_t numHalfEdges = hem.NumHalfEdges();
+    const size_t groupSize = numThreads;
+    ResizeBuffer(ws.faceCotangents, std::min(groupSize, numFrames) * numHalfEdges, ws.numAllocations);
+    ResizeBuffer(ws.edgeWeights, std::min(groupSize, numFrames) * numEdges, ws.numAllocations);
+
+    for(size_t group = 0; group < numFrames; group += groupSize) {
+        const size_t groupEnd = std::min(group + groupSize, numFrames);
+        if(Cancelled(ws, options)) {
+            return UV_MAP_CANCELLED;
+        }
+
+        float* cotangents = ws.faceCotangents.data();
+        float* weights = ws.edgeWeights.data();
+        ParallelFor(group, groupEnd, numThreads, 1, [&](size_t begin, size_t end, int) {
+            for(size_t k = begin; k < end; k++) {
+                ComputeEdgeWeights(hem, positions[k] + 0, positions[k] + 1, positions[k] + 2, 3,
+                    cotangents + (k - group) * numHalfEdges, weights + (k - group) * numEdges, 1);
+            }
+        });
+
+        // the iterative solvers start every frame from the uvs of the frame before.
+        for(size_t k = group; k < groupEnd; k++) {
+            if(!EnterStage(ws, options, UV_MAP_STAGE_ASSEMBLE)) {
+                return UV_MAP_CANCELLED;
+            }
+            MapBoundary(ws, ArrayPositions(positions[k]));
+            FillSystem(ws, M, weights + (k - group) * numEdges, matrixFree, numThreads);
+
+            UvMapStats frameStats;
+            const UvMapStatus status = SolveUnknowns(ws, budgeted, M, frameStats);
+            if(status != UV_MAP_SUCCESS) {
+                return status;
+            }
+            for(size_t i = 0; i < numVertices; i++) {
+                outUvs[k][2 * i + 0] = ws.x[i];
+                outUvs[k][2 * i + 1] = ws.y[i];
+            }
+            if(stats) {
+                stats[k] = frameStats;
+            }
+        }
+    }
+    return UV_MAP_SUCCESS;
+}
+
+UvMapStatus uvMap(
+    const std::vector<float>& inVertices,
+    const std::vector<int>& inFaces,
+
+    std::vector<float>& outVertices,
+    std::vector<int>& outFaces,
+    std::vector<float>& outUvs,
+    std::vector<float>* outUvEdges
+    ) {
+
+    UvMapWorkspace workspace;
+    UvMapWorkspace::Buffers& ws = workspace.GetBuffers();
+    const IndexedHalfEdgeMesh& hem = ws.mesh;
+
+    if(!ws.mesh.Build(
+        inVertices.data(), inVertices.size() / 3,
+        inFaces.data(), inFaces.size() / 3,
+        NumHardwareThreads())) {
+        return UV_MAP_ERROR_INVALID_MESH;
+    }
+
+    vector<float> uvs(2 * hem.NumVertices());
+    UvMapStats stats;
+    const UvMapStatus status = UvMapMesh(ws, UvMapOptions(), uvs.data(), outUvEdges, stats);
+    if(status != UV_MAP_SUCCESS) {
+        return status;
+    }
+
+    // convert back to a polygon soup. This also gives the vertices new
+    // indices, so the uvs are output in the same order.
+    vector<vec3> vVertices;
+    vector<Tri> vFaces;
+    vector<VertexIndex> vertexMap;
+    hem.ToMesh(vVertices, vFaces, &vertexMap);
+
+    for(size_t i = 0; i < vertexMap.size(); i++) {
+        outUvs.push_back(uvs[2 * vertexMap[i] + 0]);
+        outUvs.push_back(uvs[2 * vertexMap[i] + 1]);
+    }
 
     for(vec3 v: vVertices) {
         outVertices.push_back(v.x);
@@ -283,4 +1409,5 @@ void uvMap(
         outFaces.push_back(tri.i[1]);
         outFaces.push_back(tri.i[2]);
     }
+    return UV_MAP_SUCCESS;
 }
@@ -1,6 +1,356 @@
+#pragma once
 
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
 #include <vector>
 
+// The sparse solvers that uvMap can solve its linear system with.
+enum UvMapSolver {
+    // Sparse Cholesky(LDL^T) factorization. Falls back to
+    // UV_MAP_SOLVER_LU if the factorization fails.
+    UV_MAP_SOLVER_CHOLESKY,
+
+    // Sparse LU factorization.
+    UV_MAP_SOLVER_LU,
+
+    // Preconditioned Conjugate Gradient. Needs far less memory than the
+    // factorizations, since there is no fill-in, so it is the solver to use for
+    // very large meshes. Controlled by the preconditioner, tolerance,
+    // maxIterations and initialUvs options.
+    UV_MAP_SOLVER_CONJUGATE_GRADIENT,
+
+    // Smoothed aggregation algebraic multigrid V-cycles. The number of
+    // iterations hardly grows with the size of the mesh. Controlled by the
+    // tolerance, maxIterations and initialUvs options.
+    UV_MAP_SOLVER_MULTIGRID,
+
+    // Sparse Cholesky(LDL^T) factorization in single precision, which halves the
+    // memory and the bandwidth of the factor. The solution is then refined against
+    // the double precision matrix until the residual is below tolerance, usually in a
+    // couple of steps. Falls back to UV_MAP_SOLVER_CHOLESKY if the factorization fails,
+    // or if the refinement stops converging. Controlled by the tolerance and
+    // maxIterations options.
+    UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY,
+
+    // Domain decomposition. The mesh is split into numSubdomains subdomains by separators,
+    // the subdomains are factorized in parallel, independently of each other, and then only
+    // the Schur complement on the separator vertices, which is far smaller than the whole
+    // system, is factorized. Scales to far larger meshes than the other direct solvers.
+    // Falls back to UV_MAP_SOLVER_LU if a factorization fails.
+    UV_MAP_SOLVER_DOMAIN_DECOMPOSITION,
+
+    // Conjugate Gradient with the diagonal preconditioner, which never builds W. Every
+    // product with W is computed from the harmonic weights of the edges of the half edge
+    // mesh, so it takes a fraction of the memory of UV_MAP_SOLVER_CONJUGATE_GRADIENT,
+    // for meshes where even storing W is a problem. Ignores the preconditioner option.
+    // Controlled by the tolerance, maxIterations and initialUvs options.
+    UV_MAP_SOLVER_MATRIX_FREE_CONJUGATE_GRADIENT,
+};
+
+// The fill-reducing orderings of the factorizations. The fewer non-zeros the factor
+// gets (see UvMapStats::factorNonZeros), the less memory and time it takes.
+enum UvMapOrdering {
+    // Approximate minimum degree for the Cholesky factorizations,
+    // and column approximate minimum degree for LU.
+    UV_MAP_ORDERING_DEFAULT,
+
+    // Approximate minimum degree.
+    UV_MAP_ORDERING_AMD,
+
+    // Column approximate minimum degree.
+    UV_MAP_ORDERING_COLAMD,
+
+    // Nested dissection with METIS. Only if built with the AUTO_UV_METIS CMake option,
+    // otherwise UV_MAP_ORDERING_MESH_NESTED_DISSECTION is used instead.
+    UV_MAP_ORDERING_METIS,
+
+    // Nested dissection of the mesh, which splits it recursively along rings of edges
+    // around a breadth first search. Meshes have short rings everywhere, so on large meshes
+    // the factor gets far fewer non-zeros than with the minimum degree orderings.
+    UV_MAP_ORDERING_MESH_NESTED_DISSECTION,
+};
+
+// The preconditioners of UV_MAP_SOLVER_CONJUGATE_GRADIENT.
+enum UvMapPreconditioner {
+    // Jacobi preconditioning. Very cheap to set up, but needs more iterations.
+    UV_MAP_PRECONDITIONER_DIAGONAL,
+
+    // Incomplete Cholesky factorization. Takes longer to set up, but
+    // converges in far fewer iterations. Falls back to
+    // UV_MAP_PRECONDITIONER_DIAGONAL if the factorization fails.
+    UV_MAP_PRECONDITIONER_INCOMPLETE_CHOLESKY,
+
+    // A single algebraic multigrid V-cycle. The most expensive to set up, but
+    // the number of iterations stays about the same as the mesh grows, so it is
+    // the fastest for large meshes.
+    UV_MAP_PRECONDITIONER_MULTIGRID,
+};
+
+// How a uvMap call ended.
+enum UvMapStatus {
+    UV_MAP_SUCCESS,
+
+    // The faces do not make a valid mesh: a vertex index is out of range, or an
+    // edge is shared by more than two faces, or by two faces of the same orientation.
+    UV_MAP_ERROR_INVALID_MESH,
+
+    // The mesh has no boundary to map onto the circle, like a closed mesh.
+    UV_MAP_ERROR_NO_BOUNDARY,
+
+    // None of the solvers could solve the linear system, which only happens for
+    // badly degenerate meshes.
+    UV_MAP_ERROR_SOLVER_FAILED,
+
+    // The call was cancelled, see UvMapOptions::cancel.
+    UV_MAP_CANCELLED,
+};
+
+// The stages of a uvMap call, in the order they are done. See UvMapOptions::progress.
+enum UvMapStage {
+    // Building the half edge mesh.
+    UV_MAP_STAGE_BUILD,
+
+    // Finding the boundary, and mapping it onto the circle.
+    UV_MAP_STAGE_BOUNDARY,
+
+    // Mapping the simplified mesh of UvMapOptions::coarseVertices. Skipped without it.
+    UV_MAP_STAGE_PREVIEW,
+
+    // Building the linear system, from the harmonic weights of the edges.
+    UV_MAP_STAGE_ASSEMBLE,
+
+    // Factorizing the linear system, or setting up the preconditioner.
+    UV_MAP_STAGE_FACTORIZE,
+
+    // Solving the linear system, and outputting the uvs.
+    UV_MAP_STAGE_SOLVE,
+};
+
+// Options for uvMap.
+struct UvMapOptions {
+    UvMapSolver solver;
+
+    // The number of threads to build and assemble the linear system with, and to factorize
+    // it with the "supernodal" backend. 0 means one for every hardware thread. The result is the same for any number of threads.
+    int numThreads;
+
+    // The fill-reducing ordering of UV_MAP_SOLVER_CHOLESKY, UV_MAP_SOLVER_LU and
+    // UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY.
+    UvMapOrdering ordering;
+
+    // The name of the sparse direct solver backend of UV_MAP_SOLVER_CHOLESKY. NULL or "eigen"
+    // means the built-in solvers. If this build has no backend with the name (see uvMapHasBackend),
+    // or if the backend fails to factorize, the built-in solvers are used instead.
+    //
+    // "supernodal": the built-in multithreaded supernodal Cholesky factorization. It always
+    // uses the nested dissection ordering, and runs on numThreads threads.
+    //
+    // "cholmod": the supernodal Cholesky factorization of CHOLMOD, from SuiteSparse. It
+    // runs on several threads through a multithreaded BLAS. Only with the AUTO_UV_CHOLMOD
+    // CMake option. Ignores the ordering option, CHOLMOD picks its own.
+    const char* backend;
+
+    // The number of subdomains of UV_MAP_SOLVER_DOMAIN_DECOMPOSITION. The subdomains are
+    // factorized in parallel, so there should be at least one for every thread. More subdomains
+    // are smaller and faster to factorize, but have longer separators between them, and so
+    // a larger Schur complement. The result does not depend on the number of threads.
+    int numSubdomains;
+
+    //
+    // The rest are only used by the iterative solvers, and by the refinement
+    // of UV_MAP_SOLVER_MIXED_PRECISION_CHOLESKY.
+    //
+
+    UvMapPreconditioner preconditioner;
+
+    // Iterating stops once the residual |W*x - b| / |b| is below tolerance.
+    double tolerance;
+
+    // Iterating stops after at most this many iterations, even if the tolerance
+    // has not been reached. 0 means twice the number of unknowns, or 10 refinement steps.
+    int maxIterations;
+
+    // If non-null, the iterations start from these uv coordinates instead of from (0,0).
+    // Stored just like outUvs, so the uvs output by an earlier uvMap call can be passed
+    // to map a slightly edited mesh in a few iterations.
+    const float* initialUvs;
+
+    // If not 0, the iterations stop once this many milliseconds of wall-clock time have passed
+    // since the start of the call, even if they have not converged, and the uvs are those of the
+    // last iteration. See UvMapStats::converged. The factorizations and the preconditioners could
+    // block far longer than that, so the linear system is then always solved by
+    // UV_MAP_SOLVER_MATRIX_FREE_CONJUGATE_GRADIENT, whatever the solver option. Building the
+    // mesh and the weights takes time linear in the size of the mesh, and is always finished,
+    // so for large meshes the call takes somewhat longer than the budget. Pass the uvs as
+    // initialUvs to another call to go on refining them.
+    double timeBudgetMilliseconds;
+
+    // If not 0, and the mesh has more vertices than this, a simplified version of the mesh with
+    // at most this many vertices (fewer can not always be reached) is mapped first, by
+    // UV_MAP_SOLVER_CHOLESKY, and its uvs are interpolated to all the vertices. The simplified
+    // mesh keeps all the boundary vertices, so its uvs have exactly the same boundary, and they
+    // are a close approximation of the final uvs, in a fraction of the time. The iterative
+    // solvers then start from them, instead of from initialUvs, so they need far fewer
+    // iterations, and a time budget that runs out still leaves sensible uvs. Not used by uvMapBatch.
+    int coarseVertices;
+
+    // If non-null, called with the interpolated uvs of the simplified mesh (see coarseVertices),
+    // before the linear system of the mesh is solved, so the caller can already show them. The
+    // uvs are stored just like outUvs, and are only valid during the call. userData is
+    // previewUserData.
+    void (*preview)(const float* uvs, void* userData);
+    void* previewUserData;
+
+    // If non-null, checked at the start of every stage of the call (see UvMapStage), and before
+    // every iteration of the iterative solvers, and every refinement step. Once it is set, which
+    // may be done from any thread, the call stops at the next check and returns
+    // UV_MAP_CANCELLED, and the outputs are left incomplete. Building the mesh, and the
+    // factorizations and the preconditioners are finished first, so the call stops within the
+    // time of the longest of those.
+    const std::atomic<bool>* cancel;
+
+    // If non-null, called on the thread of the call at the start of every stage that the call
+    // gets to, with progressUserData. uvMapBatch reports UV_MAP_STAGE_ASSEMBLE and the stages
+    // after it for every frame.
+    void (*progress)(UvMapStage stage, void* userData);
+    void* progressUserData;
+
+    UvMapOptions() :
+        solver(UV_MAP_SOLVER_CHOLESKY),
+        numThreads(0),
+        ordering(UV_MAP_ORDERING_DEFAULT),
+        backend(NULL),
+        numSubdomains(8),
+        preconditioner(UV_MAP_PRECONDITIONER_INCOMPLETE_CHOLESKY),
+        tolerance(1e-8),
+        maxIterations(0),
+        initialUvs(NULL),
+        timeBudgetMilliseconds(0.0),
+        coarseVertices(0),
+        preview(NULL),
+        previewUserData(NULL),
+        cancel(NULL),
+        progress(NULL),
+        progressUserData(NULL) {
+    }
+};
+
+// Reports how a uvMap call went.
+struct UvMapStats {
+    // the number of iterations of the iterative solver, or of refinement steps of the
+    // mixed precision solver. The largest count of the two uv coordinates. Always 0
+    // for the other direct solvers.
+    int iterations;
+
+    // the final residual |W*x - b| / |b| of the iterative or the mixed precision solver.
+    // The largest residual of the two uv coordinates. Always 0 for the other direct solvers.
+    double residual;
+
+    // whether the uvs are the solution of the linear system. Always for the direct solvers, and
+    // for the iterative solvers whether residual got below the tolerance. Not if the iterations
+    // ran out, or the time budget ran out (see UvMapOptions::timeBudgetMilliseconds), and then
+    // the uvs are those of the last iteration, which residual is the residual of.
+    bool converged;
+
+    // the time spent on the symbolic analysis of the matrix (the fill-reducing ordering,
+    // the elimination tree and the like), and on the numeric factorization, in milliseconds.
+    double analyzeMilliseconds;
+    double factorizeMilliseconds;
+
+    // The symbolic analysis only depends on the connectivity of the mesh, so the workspace
+    // keeps it, and skips it when the next mesh has the same connectivity. This is the time
+    // the skipped analysis took when it was done, so the time that the reuse saved.
+    double savedMilliseconds;
+
+    // the number of non-zeros in the factors of the direct solvers, L and D for the Cholesky
+    // factorizations, and L and U for LU. Always 0 for the iterative solvers.
+    size_t factorNonZeros;
+
+    // the name of the backend that solved the linear system, "eigen" for the built-in solvers.
+    const char* backend;
+
+    // the partition of UV_MAP_SOLVER_DOMAIN_DECOMPOSITION: the number of subdomains, the number of
+    // unknowns on the separators, and in the smallest and in the largest subdomain. The partition
+    // is its symbolic analysis, so it is timed by analyzeMilliseconds. All 0 for the other solvers.
+    int numSubdomains;
+    int separatorSize;
+    int smallestSubdomain;
+    int largestSubdomain;
+
+    // the stages of UV_MAP_SOLVER_DOMAIN_DECOMPOSITION. Factorizing the subdomains, with their parts
+    // of the Schur complement, and factorizing the Schur complement add up to factorizeMilliseconds.
+    // Then the solve, which eliminates the subdomains, solves for the separators and back substitutes.
+    double subdomainMilliseconds;
+    double schurMilliseconds;
+    double solveMilliseconds;
+
+    // the number of vertices of the simplified mesh of UvMapOptions::coarseVertices, and the time
+    // it took to simplify the mesh, map it and interpolate its uvs. Both 0 if it was not used.
+    int coarseVertices;
+    double coarseMilliseconds;
+
+    UvMapStats() :
+        iterations(0),
+        residual(0.0),
+        converged(false),
+        analyzeMilliseconds(0.0),
+        factorizeMilliseconds(0.0),
+        savedMilliseconds(0.0),
+        factorNonZeros(0),
+        backend("eigen"),
+        numSubdomains(0),
+        separatorSize(0),
+        smallestSubdomain(0),
+        largestSubdomain(0),
+        subdomainMilliseconds(0.0),
+        schurMilliseconds(0.0),
+        solveMilliseconds(0.0),
+        coarseVertices(0),
+        coarseMilliseconds(0.0) {
+    }
+};
+
+/*
+  Holds all the memory that uvMap needs while mapping a mesh: the half edge mesh,
+  the linear system, and the solver. Pass the same workspace to several uvMap calls,
+  and every call reuses the memory of the calls before it. So once the workspace has
+  mapped a mesh, mapping another mesh that is not larger allocates none of it again.
+
+  The workspace also keeps the symbolic analysis of the linear system, keyed by a hash of its
+  sparsity pattern. So when all the meshes share the same triangles, say the frames of an
+  animation, every call after the first only has to compute the numeric factorization.
+
+  A workspace must only be used by one uvMap call at a time.
+ */
+class UvMapWorkspace {
+public:
+    UvMapWorkspace();
+    ~UvMapWorkspace();
+
+    // The number of times one of the buffers of the workspace has had to grow.
+    // If a call does not change this, then that call did not allocate any
+    // workspace memory. (the sparse solver may still allocate internally)
+    size_t NumAllocations() const;
+
+    // the buffers are only known to the uv mapper.
+    struct Buffers;
+    Buffers& GetBuffers() { return *buffers; }
+
+private:
+    UvMapWorkspace(const UvMapWorkspace&);
+    UvMapWorkspace& operator=(const UvMapWorkspace&);
+
+    std::unique_ptr<Buffers> buffers;
+};
+
+// Whether this build has the sparse direct solver backend with the name. See UvMapOptions::backend.
+bool uvMapHasBackend(const char* name);
+
+// A description of the status, for the caller to print, like "the faces do not make a valid mesh".
+const char* uvMapStatusMessage(UvMapStatus status);
+
 /*
   Automatically UV maps an input mesh with Harmonic Mapping.
 
@@ -13,8 +363,10 @@
   outUvEdges: If non-null, the function will output the UV-coordinate edges of the UV mapping.
   These are useful for visualizing the mapping. Stored as a list of two-dimensional vectors. Where every pair of vectors is one line.
 
+  Returns UV_MAP_SUCCESS, or why the mesh could not be mapped. Then the outputs are left
+  incomplete. Nothing is printed, see uvMapStatusMessage.
  */
-void uvMap(
+UvMapStatus uvMap(
     const std::vector<float>& inVertices,
     const std::vector<int>& inFaces,
 
@@ -23,3 +375,81 @@ void uvMap(
     std::vector<float>& outUvs,
     std::vector<float>* outUvEdges
     );
+
+/*
+  Same as above, but reads the input mesh directly from the caller's buffers, and
+  neither copies nor reorders it. So the output uvs line up with the input vertices.
+
+  positions: The vertex positions of the input mesh, stored as numVertices xyz-triples.
+  indices: The triangle indices of the input mesh, stored as numFaces triples in counter-clockwise order.
+
+  outUvs: Must have room for 2*numVertices floats. The UV coordinates of vertex i are written
+  to outUvs[2*i+0] and outUvs[2*i+1]. Vertices not used by any triangle get the UV coordinates (0,0).
+  outUvEdges: Same as above.
+
+ */
+UvMapStatus uvMap(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    std::vector<float>* outUvEdges
+    );
+
+/*
+  Same as above, but reuses the memory of the workspace, and is configured by options.
+  If stats is non-null, it receives the stats of the call.
+ */
+UvMapStatus uvMap(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    std::vector<float>* outUvEdges,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options = UvMapOptions(),
+    UvMapStats* stats = NULL
+    );
+
+/*
+  UV maps numFrames meshes that all have the same triangles, but different vertex
+  positions, like the frames of an animation or a set of morph targets.
+
+  The half edge mesh, the boundary and the sparsity pattern of the linear system only
+  depend on the triangles, so they are found once, from the first frame. That also
+  means that if the mesh has holes, the outer boundary is the longest boundary loop
+  of the first frame, for every frame. Then only the harmonic weights are computed
+  for every frame, for several frames in parallel, and every frame is solved.
+
+  positions: numFrames pointers, every one to the numVertices xyz-triples of a frame.
+  indices: The triangle indices shared by all the frames, stored as numFaces triples in counter-clockwise order.
+
+  outUvs: numFrames pointers, every one with room for the 2*numVertices floats of the
+  uvs of a frame, stored just like for the single mesh uvMap.
+  stats: If non-null, an array that receives the stats of every frame.
+
+  The iterative solvers start the first frame from options.initialUvs, and every
+  other frame from the uvs of the frame before.
+
+  options.timeBudgetMilliseconds is the budget of all the frames together. The frames
+  that are solved after it has run out keep the uvs that they start from.
+
+  Returns just like uvMap. If a frame fails, or the call is cancelled, the frames
+  before it have their uvs and stats, and the others are left incomplete.
+ */
+UvMapStatus uvMapBatch(
+    const float* const* positions,
+    size_t numFrames,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* const* outUvs,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options = UvMapOptions(),
+    UvMapStats* stats = NULL
+    );
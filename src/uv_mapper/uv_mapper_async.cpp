@@ -0,0 +1,221 @@
+#include "uv_mapper_async.hpp"
+#include "uv_mapper_internal.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+struct UvMapJob::State {
+    // the arguments of the call.
+    const float* positions;
+    size_t numVertices;
+    const int* indices;
+    size_t numFaces;
+    float* outUvs;
+    UvMapWorkspace* workspace;
+    std::unique_ptr<UvMapWorkspace> ownWorkspace; // if the caller passed none.
+    UvMapOptions options;
+
+    // the progress callback of the caller, which the call reports to through the job.
+    void (*progress)(UvMapStage stage, void* userData);
+    void* progressUserData;
+
+    // set by UvMapJob::Cancel. The call also stops once options.cancel is set.
+    std::atomic<bool> cancelled;
+    std::atomic<int> stage;
+
+    UvMapStats stats;
+    std::promise<UvMapStatus> promise;
+    std::shared_future<UvMapStatus> future;
+
+    State() : cancelled(false), stage(UV_MAP_STAGE_BUILD), future(promise.get_future().share()) {}
+};
+
+struct UvMapThreadPool::State {
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<std::shared_ptr<UvMapJob::State> > queue;
+    vector<std::shared_ptr<UvMapJob::State> > running; // the call of every thread, if any.
+    bool stopping;
+
+    vector<std::thread> threads;
+
+    State() : stopping(false) {}
+};
+
+static void ReportStage(UvMapStage stage, void* userData) {
+    UvMapJob::State& job = *(UvMapJob::State*)userData;
+    job.stage.store(stage);
+    if(job.progress) {
+        job.progress(stage, job.progressUserData);
+    }
+}
+
+static void RunJob(UvMapJob::State& job) {
+    try {
+        UvMapStatus status = UV_MAP_CANCELLED;
+        if(!job.cancelled.load() && !(job.options.cancel && job.options.cancel->load())) {
+            if(!job.workspace) {
+                job.ownWorkspace.reset(new UvMapWorkspace());
+                job.workspace = job.ownWorkspace.get();
+            }
+            status = uvMapCancellable(job.positions, job.numVertices, job.indices, job.numFaces,
+                job.outUvs, NULL, *job.workspace, job.options, &job.stats, &job.cancelled);
+        }
+
+        // the memory of a workspace of its own is not needed anymore.
+        job.ownWorkspace.reset();
+        job.promise.set_value(status);
+    } catch(...) {
+        // running out of memory, say. Wait and the future throw it on.
+        job.ownWorkspace.reset();
+        job.promise.set_exception(std::current_exception());
+    }
+}
+
+// the loop of thread index of the pool, which runs the calls of the queue until the pool stops.
+static void RunThread(UvMapThreadPool::State& pool, int index) {
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    for(;;) {
+        pool.wakeUp.wait(lock, [&]() { return pool.stopping || !pool.queue.empty(); });
+        // a stopping pool still finishes the calls in its queue, which are all cancelled.
+        if(pool.queue.empty()) {
+            return;
+        }
+
+        std::shared_ptr<UvMapJob::State> job = pool.queue.front();
+        pool.queue.pop_front();
+        pool.running[index] = job;
+        lock.unlock();
+
+        RunJob(*job);
+
+        lock.lock();
+        pool.running[index].reset();
+    }
+}
+
+UvMapThreadPool::UvMapThreadPool(int numThreads) : state(new State()) {
+    if(numThreads <= 0) {
+        numThreads = NumHardwareThreads();
+    }
+    state->running.resize(numThreads);
+    state->threads.reserve(numThreads);
+    for(int i = 0; i < numThreads; i++) {
+        state->threads.push_back(std::thread(RunThread, std::ref(*state), i));
+    }
+}
+
+UvMapThreadPool::~UvMapThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->stopping = true;
+        for(size_t i = 0; i < state->queue.size(); i++) {
+            state->queue[i]->cancelled.store(true);
+        }
+        for(size_t i = 0; i < state->running.size(); i++) {
+            if(state->running[i]) {
+                state->running[i]->cancelled.store(true);
+            }
+        }
+    }
+    state->wakeUp.notify_all();
+    for(size_t i = 0; i < state->threads.size(); i++) {
+        state->threads[i].join();
+    }
+}
+
+int UvMapThreadPool::NumThreads() const {
+    return state->threads.size();
+}
+
+UvMapJob::UvMapJob() {
+}
+
+UvMapJob::UvMapJob(const std::shared_ptr<State>& state) : state(state) {
+}
+
+bool UvMapJob::Valid() const {
+    return state != NULL;
+}
+
+void UvMapJob::Cancel() {
+    state->cancelled.store(true);
+}
+
+bool UvMapJob::Done() const {
+    return state->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+UvMapStage UvMapJob::Stage() const {
+    return (UvMapStage)state->stage.load();
+}
+
+UvMapStatus UvMapJob::Wait() const {
+    return state->future.get();
+}
+
+const UvMapStats& UvMapJob::Stats() const {
+    return state->stats;
+}
+
+std::shared_future<UvMapStatus> UvMapJob::Future() const {
+    return state->future;
+}
+
+// the pool of the calls without one. Made on first use, so that programs that never map
+// asynchronously start no threads.
+static UvMapThreadPool& SharedPool() {
+    static UvMapThreadPool pool;
+    return pool;
+}
+
+UvMapJob uvMapAsync(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    UvMapWorkspace* workspace,
+    const UvMapOptions& options,
+    UvMapThreadPool* pool
+    ) {
+
+    if(!pool) {
+        pool = &SharedPool();
+    }
+
+    std::shared_ptr<UvMapJob::State> job(new UvMapJob::State());
+    job->positions = positions;
+    job->numVertices = numVertices;
+    job->indices = indices;
+    job->numFaces = numFaces;
+    job->outUvs = outUvs;
+    job->workspace = workspace;
+
+    // the call reports to the job, which passes the stages on to the caller.
+    job->options = options;
+    job->options.progress = ReportStage;
+    job->options.progressUserData = job.get();
+    job->progress = options.progress;
+    job->progressUserData = options.progressUserData;
+    if(options.numThreads == 0) {
+        job->options.numThreads = std::max(1, NumHardwareThreads() / pool->NumThreads());
+    }
+
+    UvMapThreadPool::State& state = pool->GetState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.queue.push_back(job);
+    }
+    state.wakeUp.notify_one();
+    return UvMapJob(job);
+}
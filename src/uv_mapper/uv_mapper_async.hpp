@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include "uv_mapper.hpp"
+
+/*
+  A pool of threads to run uvMapAsync calls on. Every thread runs one call at a time, and
+  the calls wait for a free thread in the order they were started.
+
+  Every call still uses options.numThreads threads itself. So to keep from running more
+  threads than there are cores, either give the pool one thread for every call that should
+  run at the same time, and split the cores among them, or leave options.numThreads 0,
+  which then gives every call an equal share of the hardware threads.
+ */
+class UvMapThreadPool {
+public:
+    // numThreads 0 means one for every hardware thread.
+    explicit UvMapThreadPool(int numThreads = 0);
+
+    // Cancels all the calls of the pool, and waits for the running calls to stop.
+    ~UvMapThreadPool();
+
+    int NumThreads() const;
+
+    // the threads and the calls are only known to the pool.
+    struct State;
+    State& GetState() { return *state; }
+
+private:
+    UvMapThreadPool(const UvMapThreadPool&);
+    UvMapThreadPool& operator=(const UvMapThreadPool&);
+
+    std::unique_ptr<State> state;
+};
+
+/*
+  A handle to a uvMapAsync call. Handles are cheap to copy, and all the copies refer to the same
+  call. The call goes on even if all its handles are gone, since the pool keeps it.
+ */
+class UvMapJob {
+public:
+    // a handle that refers to no call.
+    UvMapJob();
+
+    // Whether the handle refers to a call.
+    bool Valid() const;
+
+    // Asks the call to stop, just like setting UvMapOptions::cancel does. It then finishes
+    // with UV_MAP_CANCELLED. A call that is still waiting for a thread does not start.
+    void Cancel();
+
+    // Whether the call has finished, and so Wait does not block.
+    bool Done() const;
+
+    // the last stage that the call has started. UV_MAP_STAGE_BUILD until it starts.
+    UvMapStage Stage() const;
+
+    // Waits for the call to finish, and returns its status.
+    UvMapStatus Wait() const;
+
+    // the stats of the call, once it has finished.
+    const UvMapStats& Stats() const;
+
+    // the status of the call, to wait on along with other futures.
+    std::shared_future<UvMapStatus> Future() const;
+
+    // the arguments, the progress and the result of the call.
+    struct State;
+    explicit UvMapJob(const std::shared_ptr<State>& state);
+
+private:
+    std::shared_ptr<State> state;
+};
+
+/*
+  Starts uvMap on a thread of the pool, and returns a handle to the call right away.
+
+  The arguments are the same as for uvMap, and positions, indices and outUvs must be kept until
+  the call has finished. If workspace is non-null, the call maps with it, and no other call may
+  use it until this one has finished. Otherwise the call makes a workspace of its own.
+
+  The call is cancelled by UvMapJob::Cancel, and also once options.cancel is set, if it is non-null,
+  so one flag can cancel several calls. options.progress is still called, on the thread of the
+  pool, and UvMapJob::Stage gives the stage at any time.
+
+  pool: The pool to run the call on. NULL means a pool that all the calls without one share, which
+  has a thread for every hardware thread, and is made by the first call.
+ */
+UvMapJob uvMapAsync(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    UvMapWorkspace* workspace = NULL,
+    const UvMapOptions& options = UvMapOptions(),
+    UvMapThreadPool* pool = NULL
+    );
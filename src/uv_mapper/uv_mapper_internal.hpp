@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "uv_mapper.hpp"
+
+//
+// The parts of the uv mapper that the distributed and the asynchronous uv mappers share
+// with it. Not part of the interface of the uv mapper.
+//
+
+// Builds the half edge mesh of the input in the workspace, and finds its fixed vertices and their
+// uvs, just like uvMap does. numUnknowns receives the number of unknowns, isFixed whether every
+// vertex is fixed, and x and y the uvs of the fixed vertices. Returns UV_MAP_SUCCESS, or why the
+// mesh could not be mapped, just like uvMap.
+UvMapStatus uvMapFixedVertices(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options,
+    int& numUnknowns,
+    std::vector<char>& isFixed,
+    std::vector<double>& x,
+    std::vector<double>& y);
+
+// uvMap, which also stops once *jobCancel is set, just like once *options.cancel is. uvMapAsync
+// runs its calls with it, so that both the flag of the caller and UvMapJob::Cancel cancel them.
+// jobCancel may be NULL.
+UvMapStatus uvMapCancellable(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    std::vector<float>* outUvEdges,
+    UvMapWorkspace& workspace,
+    const UvMapOptions& options,
+    UvMapStats* stats,
+    const std::atomic<bool>* jobCancel);
@@ -0,0 +1,659 @@
+#include "uv_mapper_mpi.hpp"
+#include "uv_mapper_internal.hpp"
+
+#include "indexed_half_edge_mesh.hpp"
+#include "cotangents.hpp"
+#include "linear_solvers.hpp"
+#include "multigrid.hpp"
+#include "parallel.hpp"
+
+#include "Eigen/Sparse"
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+using std::vector;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// MPI counts are ints, so large vectors are sent in pieces of at most this many bytes.
+static const size_t MAX_MESSAGE_BYTES = 1 << 30;
+
+template<typename T>
+static void SendVector(const vector<T>& v, int destination, MPI_Comm comm) {
+    unsigned long long size = v.size();
+    MPI_Send(&size, 1, MPI_UNSIGNED_LONG_LONG, destination, 0, comm);
+    const char* bytes = (const char*)v.data();
+    const size_t numBytes = v.size() * sizeof(T);
+    for(size_t offset = 0; offset < numBytes; offset += MAX_MESSAGE_BYTES) {
+        MPI_Send(bytes + offset, (int)std::min(MAX_MESSAGE_BYTES, numBytes - offset), MPI_BYTE, destination, 0, comm);
+    }
+}
+
+template<typename T>
+static void ReceiveVector(vector<T>& v, int source, MPI_Comm comm) {
+    unsigned long long size;
+    MPI_Recv(&size, 1, MPI_UNSIGNED_LONG_LONG, source, 0, comm, MPI_STATUS_IGNORE);
+    v.resize(size);
+    char* bytes = (char*)v.data();
+    const size_t numBytes = v.size() * sizeof(T);
+    for(size_t offset = 0; offset < numBytes; offset += MAX_MESSAGE_BYTES) {
+        MPI_Recv(bytes + offset, (int)std::min(MAX_MESSAGE_BYTES, numBytes - offset), MPI_BYTE, source, 0, comm, MPI_STATUS_IGNORE);
+    }
+}
+
+//
+// The part of the mesh that one process assembles its rows of W from: the faces around the
+// unknown vertices it owns, with local vertex indices. The owned vertices come first, and
+// owned vertex i is unknown firstUnknown + i. Every unknown is owned by exactly one process.
+//
+struct LocalMesh {
+    int numOwned;
+    int firstUnknown;
+
+    vector<float> positions; // xyz of every local vertex.
+    vector<int> indices;
+    vector<int> unknowns; // the unknown of every local vertex, or -1 if it is fixed.
+    vector<double> fixedUvs; // the uv of every local vertex, if it is fixed.
+    vector<double> initialUvs; // the uv of every owned vertex, if options.initialUvs is set.
+
+    void Send(int destination, MPI_Comm comm) const {
+        int header[2] = { numOwned, firstUnknown };
+        MPI_Send(header, 2, MPI_INT, destination, 0, comm);
+        SendVector(positions, destination, comm);
+        SendVector(indices, destination, comm);
+        SendVector(unknowns, destination, comm);
+        SendVector(fixedUvs, destination, comm);
+        SendVector(initialUvs, destination, comm);
+    }
+
+    void Receive(int source, MPI_Comm comm) {
+        int header[2];
+        MPI_Recv(header, 2, MPI_INT, source, 0, comm, MPI_STATUS_IGNORE);
+        numOwned = header[0];
+        firstUnknown = header[1];
+        ReceiveVector(positions, source, comm);
+        ReceiveVector(indices, source, comm);
+        ReceiveVector(unknowns, source, comm);
+        ReceiveVector(fixedUvs, source, comm);
+        ReceiveVector(initialUvs, source, comm);
+    }
+};
+
+//
+// Splits the vertices into numParts parts of about the same size, by recursive coordinate
+// bisection: every range of vertices is split across the longest side of its bounding box.
+// vertices is reordered so that part p is [partBegin[p], partBegin[p+1]). Only needs the
+// positions, so rank 0 never has to hold the graph of W.
+//
+static void PartitionByCoordinates(const float* positions, vector<uint32_t>& vertices, int numParts, vector<size_t>& partBegin) {
+    struct Range {
+        size_t begin;
+        size_t end;
+        int firstPart;
+        int numParts;
+    };
+    partBegin.assign(numParts + 1, vertices.size());
+    vector<Range> ranges;
+    Range all = { 0, vertices.size(), 0, numParts };
+    ranges.push_back(all);
+    while(!ranges.empty()) {
+        const Range range = ranges.back();
+        ranges.pop_back();
+        if(range.numParts == 1) {
+            partBegin[range.firstPart] = range.begin;
+            continue;
+        }
+
+        float lower[3] = { 0.0f, 0.0f, 0.0f };
+        float upper[3] = { 0.0f, 0.0f, 0.0f };
+        for(size_t i = range.begin; i < range.end; i++) {
+            for(int k = 0; k < 3; k++) {
+                const float p = positions[3 * vertices[i] + k];
+                lower[k] = i == range.begin ? p : std::min(lower[k], p);
+                upper[k] = i == range.begin ? p : std::max(upper[k], p);
+            }
+        }
+        int axis = 0;
+        for(int k = 1; k < 3; k++) {
+            if(upper[k] - lower[k] > upper[axis] - lower[axis]) {
+                axis = k;
+            }
+        }
+
+        // ties are broken by the index, so that the split is the same on every machine.
+        const int partsA = range.numParts / 2;
+        const size_t middle = range.begin + (range.end - range.begin) * partsA / range.numParts;
+        std::nth_element(vertices.begin() + range.begin, vertices.begin() + middle, vertices.begin() + range.end,
+            [&](uint32_t a, uint32_t b) {
+                const float pa = positions[3 * a + axis];
+                const float pb = positions[3 * b + axis];
+                return pa != pb ? pa < pb : a < b;
+            });
+
+        Range a = { range.begin, middle, range.firstPart, partsA };
+        Range b = { middle, range.end, range.firstPart + partsA, range.numParts - partsA };
+        ranges.push_back(a);
+        ranges.push_back(b);
+    }
+}
+
+//
+// The rows of W that one process owns, and the right hand sides of those rows. The columns
+// are the owned unknowns, followed by the ghosts: the unknowns of other processes that the
+// owned rows have elements for. Before a multiplication with W, every process receives the
+// values of its ghosts from the processes that own them.
+//
+class DistributedSystem {
+public:
+    typedef Eigen::SparseMatrix<double, Eigen::RowMajor> RowMatrix;
+
+    int numOwned;
+    RowMatrix A;
+    SparseMatrix diagonalBlock; // the owned columns of A, for the preconditioner.
+    Eigen::MatrixXd B;
+
+    void Assemble(const LocalMesh& mesh, int numThreads, MPI_Comm comm);
+
+    // Q = W * P, for the owned rows of the columns of P. P has a row for every owned unknown
+    // and every ghost, and the ghost rows are received first.
+    void Multiply(Eigen::MatrixXd& P, Eigen::MatrixXd& Q);
+
+private:
+    MPI_Comm comm;
+
+    // the ghosts of recvRanks[i] are ghosts recvBegin[i] to recvBegin[i+1].
+    vector<int> recvRanks;
+    vector<int> recvBegin;
+    // the owned unknowns sendIndices[sendBegin[i]] to sendIndices[sendBegin[i+1]] are sent to sendRanks[i].
+    vector<int> sendRanks;
+    vector<int> sendBegin;
+    vector<int> sendIndices;
+
+    vector<double> sendBuffer;
+    vector<double> recvBuffer;
+    vector<MPI_Request> requests;
+};
+
+void DistributedSystem::Assemble(const LocalMesh& mesh, int numThreads, MPI_Comm comm) {
+    this->comm = comm;
+    numOwned = mesh.numOwned;
+    const int numLocal = mesh.unknowns.size();
+    const size_t numFaces = mesh.indices.size() / 3;
+
+    // the harmonic weights of the edges around the owned vertices, just like uvMap computes them.
+    // All the faces around an owned vertex are local, so an edge of an owned vertex is only on
+    // the boundary of the local mesh if it is on the boundary of the whole mesh.
+    IndexedHalfEdgeMesh hem(mesh.positions.data(), numLocal, mesh.indices.data(), numFaces, numThreads);
+    vector<float> cotangents(hem.NumHalfEdges());
+    FaceCotangents(hem.PositionsX(), hem.PositionsY(), hem.PositionsZ(), 1, hem.FaceVertices(), 0, numFaces, cotangents.data());
+
+    // the unknowns of other processes that the owned rows need.
+    vector<int> ghosts;
+    const int lastUnknown = mesh.firstUnknown + numOwned;
+    for(int i = numOwned; i < numLocal; i++) {
+        if(mesh.unknowns[i] != -1 && (mesh.unknowns[i] < mesh.firstUnknown || mesh.unknowns[i] >= lastUnknown)) {
+            ghosts.push_back(mesh.unknowns[i]);
+        }
+    }
+    std::sort(ghosts.begin(), ghosts.end());
+    ghosts.erase(std::unique(ghosts.begin(), ghosts.end()), ghosts.end());
+
+    vector< Eigen::Triplet<double> > elements;
+    vector< Eigen::Triplet<double> > blockElements;
+    B.resize(numOwned, 2);
+    for(int i0 = 0; i0 < numOwned; i0++) {
+        double diag = 0.0;
+        double sumX = 0.0;
+        double sumY = 0.0;
+        for(const EdgeIndex* e = hem.VertexEdgesBegin(i0); e != hem.VertexEdgesEnd(i0); e++) {
+            if(hem.IsBoundaryEdge(*e)) {
+                continue;
+            }
+
+            HalfEdgeIndex he = hem.EdgeHalfEdge(*e);
+            VertexIndex i1 = hem.Vertex(he) == (VertexIndex)i0 ? hem.Vertex(hem.Next(he)) : hem.Vertex(he);
+            float weight = (cotangents[he] + cotangents[hem.Twin(he)]) * 0.5f;
+
+            diag += weight;
+            const int u1 = mesh.unknowns[i1];
+            if(u1 == -1) {
+                sumX += weight * mesh.fixedUvs[2 * i1 + 0];
+                sumY += weight * mesh.fixedUvs[2 * i1 + 1];
+            } else if(i1 != (VertexIndex)i0) {
+                int column;
+                if(u1 >= mesh.firstUnknown && u1 < lastUnknown) {
+                    column = u1 - mesh.firstUnknown;
+                    blockElements.push_back(Eigen::Triplet<double>(i0, column, -weight));
+                } else {
+                    column = numOwned + (std::lower_bound(ghosts.begin(), ghosts.end(), u1) - ghosts.begin());
+                }
+                elements.push_back(Eigen::Triplet<double>(i0, column, -weight));
+            }
+        }
+        elements.push_back(Eigen::Triplet<double>(i0, i0, diag));
+        blockElements.push_back(Eigen::Triplet<double>(i0, i0, diag));
+        B(i0, 0) = sumX;
+        B(i0, 1) = sumY;
+    }
+    A.resize(numOwned, numOwned + ghosts.size());
+    A.setFromTriplets(elements.begin(), elements.end());
+    diagonalBlock.resize(numOwned, numOwned);
+    diagonalBlock.setFromTriplets(blockElements.begin(), blockElements.end());
+
+    //
+    // Every process owns a contiguous range of unknowns, so the owner of every ghost is found
+    // from the first unknowns of all the processes. The ghosts are sorted, so the ghosts of
+    // every process are contiguous. Then every process tells the owners which ghosts it needs.
+    //
+    int numRanks;
+    MPI_Comm_size(comm, &numRanks);
+    vector<int> firstUnknowns(numRanks);
+    MPI_Allgather(&mesh.firstUnknown, 1, MPI_INT, firstUnknowns.data(), 1, MPI_INT, comm);
+
+    vector<int> recvCounts(numRanks, 0);
+    for(size_t g = 0; g < ghosts.size(); g++) {
+        const int owner = std::upper_bound(firstUnknowns.begin(), firstUnknowns.end(), ghosts[g]) - firstUnknowns.begin() - 1;
+        recvCounts[owner]++;
+    }
+    vector<int> sendCounts(numRanks);
+    MPI_Alltoall(recvCounts.data(), 1, MPI_INT, sendCounts.data(), 1, MPI_INT, comm);
+
+    vector<int> recvDisplacements(numRanks + 1, 0);
+    vector<int> sendDisplacements(numRanks + 1, 0);
+    for(int q = 0; q < numRanks; q++) {
+        recvDisplacements[q + 1] = recvDisplacements[q] + recvCounts[q];
+        sendDisplacements[q + 1] = sendDisplacements[q] + sendCounts[q];
+    }
+    sendIndices.resize(sendDisplacements[numRanks]);
+    MPI_Alltoallv(ghosts.data(), recvCounts.data(), recvDisplacements.data(), MPI_INT,
+                  sendIndices.data(), sendCounts.data(), sendDisplacements.data(), MPI_INT, comm);
+    for(size_t i = 0; i < sendIndices.size(); i++) {
+        sendIndices[i] -= mesh.firstUnknown;
+    }
+
+    recvRanks.clear();
+    recvBegin.assign(1, 0);
+    sendRanks.clear();
+    sendBegin.assign(1, 0);
+    for(int q = 0; q < numRanks; q++) {
+        if(recvCounts[q] > 0) {
+            recvRanks.push_back(q);
+            recvBegin.push_back(recvDisplacements[q + 1]);
+        }
+        if(sendCounts[q] > 0) {
+            sendRanks.push_back(q);
+            sendBegin.push_back(sendDisplacements[q + 1]);
+        }
+    }
+}
+
+void DistributedSystem::Multiply(Eigen::MatrixXd& P, Eigen::MatrixXd& Q) {
+    const int K = P.cols();
+    sendBuffer.resize(sendIndices.size() * K);
+    recvBuffer.resize((A.cols() - numOwned) * K);
+    requests.resize(recvRanks.size() + sendRanks.size());
+
+    for(size_t i = 0; i < recvRanks.size(); i++) {
+        const int count = (recvBegin[i + 1] - recvBegin[i]) * K;
+        MPI_Irecv(recvBuffer.data() + recvBegin[i] * K, count, MPI_DOUBLE, recvRanks[i], 1, comm, &requests[i]);
+    }
+    for(size_t i = 0; i < sendRanks.size(); i++) {
+        double* buffer = sendBuffer.data() + sendBegin[i] * K;
+        for(int s = sendBegin[i]; s < sendBegin[i + 1]; s++) {
+            for(int c = 0; c < K; c++) {
+                *buffer++ = P(sendIndices[s], c);
+            }
+        }
+        const int count = (sendBegin[i + 1] - sendBegin[i]) * K;
+        MPI_Isend(sendBuffer.data() + sendBegin[i] * K, count, MPI_DOUBLE, sendRanks[i], 1, comm, &requests[recvRanks.size() + i]);
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    for(int g = 0; g < A.cols() - numOwned; g++) {
+        for(int c = 0; c < K; c++) {
+            P(numOwned + g, c) = recvBuffer[g * K + c];
+        }
+    }
+    Q.noalias() = A * P;
+}
+
+// the sums of the columns of the products of X and Y over all the processes.
+static void ColumnDots(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, int numOwned, double* dots, MPI_Comm comm) {
+    const int K = X.cols();
+    vector<double> local(K);
+    for(int c = 0; c < K; c++) {
+        local[c] = X.col(c).head(numOwned).dot(Y.col(c).head(numOwned));
+    }
+    MPI_Allreduce(local.data(), dots, K, MPI_DOUBLE, MPI_SUM, comm);
+}
+
+//
+// Preconditioned Conjugate Gradient, for both uv coordinates at once, so that both share every
+// exchange of ghosts and every reduction. Every column is iterated until it converges by itself,
+// just like Eigen::ConjugateGradient, whose steps these are. X starts from the initial guess.
+//
+template<typename Preconditioner>
+static void SolvePcg(
+    DistributedSystem& system, const Preconditioner& preconditioner, Eigen::MatrixXd& X,
+    double tolerance, int maxIterations, MPI_Comm comm, int& iterations, double& residual) {
+
+    const int n = system.numOwned;
+    const int numColumns = system.A.cols();
+    const int K = system.B.cols();
+
+    // P and X have rows for the ghosts too.
+    Eigen::MatrixXd P = Eigen::MatrixXd::Zero(numColumns, K);
+    Eigen::MatrixXd Q(n, K);
+    Eigen::MatrixXd R(n, K);
+    Eigen::MatrixXd Z(n, K);
+
+    system.Multiply(X, Q);
+    R = system.B - Q;
+
+    vector<double> rhsNorm2(K);
+    vector<double> residualNorm2(K);
+    vector<double> threshold(K);
+    vector<double> absNew(K);
+    vector<double> dots(K);
+    vector<char> active(K);
+    ColumnDots(system.B, system.B, n, rhsNorm2.data(), comm);
+    ColumnDots(R, R, n, residualNorm2.data(), comm);
+    bool anyActive = false;
+    for(int c = 0; c < K; c++) {
+        if(rhsNorm2[c] == 0.0) {
+            X.col(c).setZero();
+            R.col(c).setZero();
+            residualNorm2[c] = 0.0;
+        }
+        threshold[c] = std::max(tolerance * tolerance * rhsNorm2[c], (double)std::numeric_limits<double>::min());
+        active[c] = residualNorm2[c] >= threshold[c];
+        anyActive = anyActive || active[c];
+    }
+
+    for(int c = 0; c < K && n > 0; c++) {
+        Z.col(c) = preconditioner.solve(R.col(c));
+    }
+    P.topRows(n) = Z;
+    ColumnDots(R, Z, n, absNew.data(), comm);
+
+    iterations = 0;
+    while(anyActive && iterations < maxIterations) {
+        system.Multiply(P, Q);
+        ColumnDots(P, Q, n, dots.data(), comm);
+        for(int c = 0; c < K; c++) {
+            if(active[c]) {
+                const double alpha = absNew[c] / dots[c];
+                X.col(c).head(n) += alpha * P.col(c).head(n);
+                R.col(c) -= alpha * Q.col(c);
+            }
+        }
+        iterations++;
+
+        ColumnDots(R, R, n, residualNorm2.data(), comm);
+        anyActive = false;
+        for(int c = 0; c < K; c++) {
+            active[c] = active[c] && residualNorm2[c] >= threshold[c];
+            anyActive = anyActive || active[c];
+        }
+        if(!anyActive) {
+            break;
+        }
+
+        for(int c = 0; c < K && n > 0; c++) {
+            Z.col(c) = preconditioner.solve(R.col(c));
+        }
+        vector<double> absOld(absNew);
+        ColumnDots(R, Z, n, absNew.data(), comm);
+        for(int c = 0; c < K; c++) {
+            if(active[c]) {
+                P.col(c).head(n) = Z.col(c) + (absNew[c] / absOld[c]) * P.col(c).head(n);
+            }
+        }
+    }
+
+    residual = 0.0;
+    for(int c = 0; c < K; c++) {
+        if(rhsNorm2[c] > 0.0) {
+            residual = std::max(residual, std::sqrt(residualNorm2[c] / rhsNorm2[c]));
+        }
+    }
+}
+
+// Computes the preconditioner of the block of the process, and solves. Returns false if the
+// preconditioner failed on any process, so that all of them fall back to the same one.
+template<typename Preconditioner>
+static bool SolveDistributed(
+    DistributedSystem& system, Eigen::MatrixXd& X, const UvMapOptions& options, int numUnknowns,
+    MPI_Comm comm, UvMapStats& stats) {
+
+    Clock::time_point start = Clock::now();
+    Preconditioner preconditioner;
+    int failed = 0;
+    if(system.numOwned > 0) {
+        preconditioner.compute(system.diagonalBlock);
+        failed = preconditioner.info() != Eigen::Success;
+    }
+    int anyFailed = 0;
+    MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_MAX, comm);
+    stats.factorizeMilliseconds = MillisecondsSince(start);
+    if(anyFailed) {
+        return false;
+    }
+
+    const int maxIterations = options.maxIterations > 0 ? options.maxIterations : 2 * numUnknowns;
+    SolvePcg(system, preconditioner, X, options.tolerance, maxIterations, comm, stats.iterations, stats.residual);
+    return true;
+}
+
+UvMapStatus uvMapDistributed(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    const UvMapOptions& options,
+    MPI_Comm comm,
+    UvMapStats* stats
+    ) {
+
+    int rank;
+    int numRanks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &numRanks);
+    const int numThreads = options.numThreads > 0 ? options.numThreads : NumHardwareThreads();
+    Clock::time_point start = Clock::now();
+
+    //
+    // Rank 0 finds the fixed vertices, splits the unknowns into the parts of the processes,
+    // and sends every process its part of the mesh.
+    //
+    LocalMesh localMesh;
+    vector<char> isFixed;
+    vector<double> x;
+    vector<double> y;
+    vector<uint32_t> unknownVertices; // the vertex of every unknown.
+    vector<size_t> partBegin;
+    int numUnknowns = 0;
+    int status = UV_MAP_SUCCESS;
+    if(rank == 0) {
+        UvMapWorkspace workspace;
+        status = uvMapFixedVertices(positions, numVertices, indices, numFaces, workspace, options, numUnknowns, isFixed, x, y);
+    }
+
+    // all the processes stop if rank 0 can not map the mesh.
+    int header[2] = { status, numUnknowns };
+    MPI_Bcast(header, 2, MPI_INT, 0, comm);
+    status = header[0];
+    numUnknowns = header[1];
+    if(status != UV_MAP_SUCCESS) {
+        return (UvMapStatus)status;
+    }
+
+    if(rank == 0) {
+
+        for(size_t v = 0; v < numVertices; v++) {
+            if(!isFixed[v]) {
+                unknownVertices.push_back(v);
+            }
+        }
+        PartitionByCoordinates(positions, unknownVertices, numRanks, partBegin);
+
+        vector<int> owner(numVertices, -1);
+        vector<int> unknown(numVertices, -1);
+        for(int q = 0; q < numRanks; q++) {
+            for(size_t u = partBegin[q]; u < partBegin[q + 1]; u++) {
+                owner[unknownVertices[u]] = q;
+                unknown[unknownVertices[u]] = u;
+            }
+        }
+
+        // the faces of every part, the faces with a vertex it owns. A face has at most three
+        // owners, so the faces are bucketed in one pass, and stay in order within every part.
+        vector<size_t> partFaceOffsets(numRanks + 1, 0);
+        vector<uint32_t> partFaces;
+        for(int pass = 0; pass < 2; pass++) {
+            for(size_t f = 0; f < numFaces; f++) {
+                const int* face = indices + 3 * f;
+                for(int k = 0; k < 3; k++) {
+                    const int q = owner[face[k]];
+                    if(q == -1 || (k > 0 && q == owner[face[0]]) || (k > 1 && q == owner[face[1]])) {
+                        continue;
+                    }
+                    if(pass == 0) {
+                        partFaceOffsets[q + 1]++;
+                    } else {
+                        partFaces[partFaceOffsets[q]++] = f;
+                    }
+                }
+            }
+            if(pass == 0) {
+                for(int q = 0; q < numRanks; q++) {
+                    partFaceOffsets[q + 1] += partFaceOffsets[q];
+                }
+                partFaces.resize(partFaceOffsets[numRanks]);
+            } else {
+                // the offsets were moved on to the end of every part.
+                for(int q = numRanks; q > 0; q--) {
+                    partFaceOffsets[q] = partFaceOffsets[q - 1];
+                }
+                partFaceOffsets[0] = 0;
+            }
+        }
+
+        // the parts are sent one at a time, so rank 0 only holds one part besides its own.
+        vector<uint32_t> localIndex(numVertices, INVALID_INDEX);
+        vector<uint32_t> localVertices;
+        for(int q = numRanks - 1; q >= 0; q--) {
+            LocalMesh part;
+            part.numOwned = partBegin[q + 1] - partBegin[q];
+            part.firstUnknown = partBegin[q];
+            localVertices.assign(unknownVertices.begin() + partBegin[q], unknownVertices.begin() + partBegin[q + 1]);
+            for(size_t i = 0; i < localVertices.size(); i++) {
+                localIndex[localVertices[i]] = i;
+            }
+            for(size_t i = partFaceOffsets[q]; i < partFaceOffsets[q + 1]; i++) {
+                const int* face = indices + 3 * partFaces[i];
+                for(int k = 0; k < 3; k++) {
+                    if(localIndex[face[k]] == INVALID_INDEX) {
+                        localIndex[face[k]] = localVertices.size();
+                        localVertices.push_back(face[k]);
+                    }
+                    part.indices.push_back(localIndex[face[k]]);
+                }
+            }
+            for(size_t i = 0; i < localVertices.size(); i++) {
+                const uint32_t v = localVertices[i];
+                part.positions.push_back(positions[3 * v + 0]);
+                part.positions.push_back(positions[3 * v + 1]);
+                part.positions.push_back(positions[3 * v + 2]);
+                part.unknowns.push_back(unknown[v]);
+                part.fixedUvs.push_back(x[v]);
+                part.fixedUvs.push_back(y[v]);
+                if(options.initialUvs && (int)i < part.numOwned) {
+                    part.initialUvs.push_back(options.initialUvs[2 * v + 0]);
+                    part.initialUvs.push_back(options.initialUvs[2 * v + 1]);
+                }
+                localIndex[v] = INVALID_INDEX;
+            }
+
+            if(q == 0) {
+                localMesh = part;
+            } else {
+                part.Send(q, comm);
+            }
+        }
+    } else {
+        localMesh.Receive(0, comm);
+    }
+
+    DistributedSystem system;
+    system.Assemble(localMesh, numThreads, comm);
+    const int n = system.numOwned;
+
+    Eigen::MatrixXd X = Eigen::MatrixXd::Zero(system.A.cols(), 2);
+    if(!localMesh.initialUvs.empty()) {
+        for(int i = 0; i < n; i++) {
+            X(i, 0) = localMesh.initialUvs[2 * i + 0];
+            X(i, 1) = localMesh.initialUvs[2 * i + 1];
+        }
+    }
+    localMesh = LocalMesh();
+
+    UvMapStats localStats;
+    localStats.analyzeMilliseconds = MillisecondsSince(start);
+
+    // every process falls back to the diagonal just like CG of uvMap does, since they all
+    // know whether any of them failed.
+    bool solved = false;
+    if(options.preconditioner == UV_MAP_PRECONDITIONER_INCOMPLETE_CHOLESKY) {
+        solved = SolveDistributed< Eigen::IncompleteCholesky<double> >(system, X, options, numUnknowns, comm, localStats);
+    } else if(options.preconditioner == UV_MAP_PRECONDITIONER_MULTIGRID) {
+        solved = SolveDistributed<AlgebraicMultigrid>(system, X, options, numUnknowns, comm, localStats);
+    }
+    if(!solved && !SolveDistributed< Eigen::DiagonalPreconditioner<double> >(system, X, options, numUnknowns, comm, localStats)) {
+        return UV_MAP_ERROR_SOLVER_FAILED;
+    }
+
+    //
+    // rank 0 gathers the uvs of all the unknowns, which every process holds in the order
+    // of its range of unknowns, first all the u and then all the v.
+    //
+    Eigen::MatrixXd owned = X.topRows(n);
+    vector<int> counts(numRanks);
+    vector<int> displacements(numRanks + 1, 0);
+    const int count = 2 * n;
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    for(int q = 0; q < numRanks; q++) {
+        displacements[q + 1] = displacements[q] + counts[q];
+    }
+    vector<double> gathered(rank == 0 ? displacements[numRanks] : 0);
+    MPI_Gatherv(owned.data(), count, MPI_DOUBLE, gathered.data(), counts.data(), displacements.data(), MPI_DOUBLE, 0, comm);
+
+    if(rank == 0) {
+        for(size_t v = 0; v < numVertices; v++) {
+            outUvs[2 * v + 0] = x[v];
+            outUvs[2 * v + 1] = y[v];
+        }
+        for(int q = 0; q < numRanks; q++) {
+            const int size = partBegin[q + 1] - partBegin[q];
+            for(int i = 0; i < size; i++) {
+                const uint32_t v = unknownVertices[partBegin[q] + i];
+                outUvs[2 * v + 0] = gathered[displacements[q] + i];
+                outUvs[2 * v + 1] = gathered[displacements[q] + size + i];
+            }
+        }
+    }
+    if(stats) {
+        *stats = localStats;
+    }
+    return UV_MAP_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <mpi.h>
+#include "uv_mapper.hpp"
+
+/*
+  Same as uvMap, but the linear system is distributed over all the processes of comm, for
+  meshes whose linear system does not fit in the memory of one machine. Must be called by all
+  the processes of comm together.
+
+  Only rank 0 reads the input mesh, and only rank 0 receives the uvs. The other ranks may pass
+  NULL and 0 for positions, numVertices, indices, numFaces and outUvs.
+
+  Rank 0 finds the fixed boundary just like uvMap does, which only needs the connectivity of
+  the mesh, and splits the unknown vertices into one part for every process, by recursive
+  coordinate bisection. Every process then receives the faces around the vertices of its part,
+  computes their harmonic weights itself, and assembles its rows of W. The system is solved by
+  preconditioned Conjugate Gradient, where every process only multiplies with its own rows of W,
+  after exchanging the uvs of the vertices that its rows share with the neighbouring parts.
+
+  options.preconditioner is applied to the block of W of every process by itself (block Jacobi).
+  options.tolerance and options.maxIterations work just like for UV_MAP_SOLVER_CONJUGATE_GRADIENT,
+  and options.initialUvs is read on rank 0. The other solver options are ignored, there is no
+  distributed factorization. So the uvs agree with those of uvMap to the tolerance.
+
+  stats receives the iterations and the residual, which are the same on all processes.
+  analyzeMilliseconds is the time it took to distribute and assemble the system, and
+  factorizeMilliseconds the time of the preconditioner of this process.
+
+  Returns the same status on all the processes: UV_MAP_SUCCESS, or why the mesh could not be
+  mapped, just like uvMap. Then outUvs is left incomplete.
+ */
+UvMapStatus uvMapDistributed(
+    const float* positions,
+    size_t numVertices,
+    const int* indices,
+    size_t numFaces,
+
+    float* outUvs,
+    const UvMapOptions& options,
+    MPI_Comm comm,
+    UvMapStats* stats = NULL
+    );